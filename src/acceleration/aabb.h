@@ -32,30 +32,70 @@ public:
 
     bool hit(const ray& r,
              interval ray_t) const {
+        double t_enter;
+        return hit(r, ray_t, t_enter);
+    }
+
+    // As above, also reporting where the ray enters the box.
+    bool hit(const ray& r,
+             interval ray_t,
+             double& t_enter) const {
+
+        bool hit_box = clip(r, ray_t);
+        t_enter = ray_t.min;
+        return hit_box;
+    }
+
+    // Narrows ray_t to the part of the ray inside the box.
+    bool clip(const ray& r,
+              interval& ray_t) const {
+
+        const point3& origin = r.origin();
+        const vec3& inv_dir = r.inv_direction();
 
+        // Slab test without divisions or per-axis branches: the ray's
+        // sign picks which face is entered first.
         for (int axis = 0; axis < 3; axis++) {
 
             const interval& ax = axis_interval(axis);
+            const int neg = r.sign(axis);
 
-            auto invD = 1.0 / r.direction()[axis];
+            auto t0 = ((neg ? ax.max : ax.min) - origin[axis]) * inv_dir[axis];
+            auto t1 = ((neg ? ax.min : ax.max) - origin[axis]) * inv_dir[axis];
 
-            auto t0 = (ax.min - r.origin()[axis]) * invD;
-            auto t1 = (ax.max - r.origin()[axis]) * invD;
+            ray_t.min = t0 > ray_t.min ? t0 : ray_t.min;
+            ray_t.max = t1 < ray_t.max ? t1 : ray_t.max;
+        }
 
-            if (invD < 0.0)
-                std::swap(t0, t1);
+        return ray_t.min < ray_t.max;
+    }
 
-            if (t0 > ray_t.min) ray_t.min = t0;
-            if (t1 < ray_t.max) ray_t.max = t1;
+    point3 centroid() const {
+        return point3(0.5 * (x.min + x.max),
+                      0.5 * (y.min + y.max),
+                      0.5 * (z.min + z.max));
+    }
 
-            if (ray_t.max <= ray_t.min)
-                return false;
-        }
+    double surface_area() const {
+        if (x.min > x.max || y.min > y.max || z.min > z.max)
+            return 0.0;
 
-        return true;
+        auto dx = x.size();
+        auto dy = y.size();
+        auto dz = z.size();
+
+        return 2.0 * (dx*dy + dy*dz + dz*dx);
     }
 };
 
+// Identity for surrounding_box: grows to whatever it is merged with.
+inline aabb empty_box() {
+    const double inf = std::numeric_limits<double>::infinity();
+    return aabb(interval(inf, -inf),
+                interval(inf, -inf),
+                interval(inf, -inf));
+}
+
 inline aabb surrounding_box(const aabb& box0,
                             const aabb& box1) {
 
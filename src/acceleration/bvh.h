@@ -5,6 +5,7 @@
 #include "hittable.h"
 #include "hittable_list.h"
 #include "aabb.h"
+#include "sah.h"
 #include <memory>
 #include <algorithm>
 
@@ -18,8 +19,131 @@ public:
         size_t end,
         double time0,
         double time1
+    ) : bvh_node(objects, start, end, time0, time1,
+                 bvh_build_options()) {}
+
+    bvh_node(
+        std::vector<std::shared_ptr<hittable>>& objects,
+        size_t start,
+        size_t end,
+        double time0,
+        double time1,
+        const bvh_build_options& options,
+        int depth = 0
+    ) {
+        // Like bvh_builder, SAH gives way to median splits deep in the
+        // tree, so a flattened copy stays within the traversal stack.
+        if (options.split == bvh_split_method::sah && depth < bvh_median_depth)
+            build_sah(objects, start, end, time0, time1, options, depth);
+        else
+            build_median(objects, start, end, time0, time1, options, depth);
+
+        aabb box_left, box_right;
+
+        if (!left->bounding_box(time0, time1, box_left)
+         || !right->bounding_box(time0, time1, box_right))
+            std::cerr << "No bounding box in BVH constructor.\n";
+
+        box = surrounding_box(box_left, box_right);
+    }
+
+    virtual bool hit(
+        const ray& r,
+        const interval& ray_t,
+        hit_record& rec
+    ) const override {
+
+        if (!box.hit(r, ray_t))
+            return false;
+
+        if (right == left)
+            return left->hit(r, ray_t, rec);
+
+        // Visit the child on the ray's side of the split first; a hit
+        // there shrinks the interval so the far child's own box test
+        // rejects it unless it starts before that hit.
+        bool right_first = r.direction()[split_axis] < 0;
+        const auto& near = right_first ? right : left;
+        const auto& far  = right_first ? left  : right;
+
+        bool hit_near =
+            near->hit(r, ray_t, rec);
+
+        bool hit_far =
+            far->hit(
+                r,
+                interval(ray_t.min,
+                         hit_near ? rec.t : ray_t.max),
+                rec
+            );
+
+        return hit_near || hit_far;
+    }
+
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+
+        if (!box.hit(r, ray_t))
+            return false;
+
+        if (left->occluded(r, ray_t))
+            return true;
+
+        return right != left && right->occluded(r, ray_t);
+    }
+
+    virtual bool bounding_box(
+        double time0,
+        double time1,
+        aabb& output_box
+    ) const override {
+        output_box = box;
+        return true;
+    }
+
+    // Recomputes boxes bottom-up for the objects' current positions,
+    // keeping the tree's topology.
+    void refit(double time0, double time1) {
+        for (const auto& child : { left, right }) {
+            if (auto node = std::dynamic_pointer_cast<bvh_node>(child))
+                node->refit(time0, time1);
+        }
+
+        aabb box_left, box_right;
+        left->bounding_box(time0, time1, box_left);
+        right->bounding_box(time0, time1, box_right);
+        box = surrounding_box(box_left, box_right);
+    }
+
+    // Expected cost of one ray query under the surface area heuristic,
+    // relative to the root box. Leaf objects are charged at the area of
+    // the node that owns them, since their boxes are not tested first.
+    double sah_cost(
+        const bvh_build_options& options = bvh_build_options()
+    ) const {
+        return subtree_cost(options) / box.surface_area();
+    }
+
+public:
+    std::shared_ptr<hittable> left;
+    std::shared_ptr<hittable> right;
+    aabb box;
+    int split_axis = 0;  // left holds the lower half along this axis
+
+private:
+    void build_median(
+        std::vector<std::shared_ptr<hittable>>& objects,
+        size_t start,
+        size_t end,
+        double time0,
+        double time1,
+        const bvh_build_options& options,
+        int depth
     ) {
         int axis = random_int(0, 2);
+        split_axis = axis;
         auto comparator = (axis == 0) ? box_x_compare
                         : (axis == 1) ? box_y_compare
                                       : box_z_compare;
@@ -46,59 +170,96 @@ public:
             auto mid = start + object_span / 2;
 
             left  = std::make_shared<bvh_node>(
-                objects, start, mid, time0, time1);
+                objects, start, mid, time0, time1, options, depth + 1);
 
             right = std::make_shared<bvh_node>(
-                objects, mid, end, time0, time1);
+                objects, mid, end, time0, time1, options, depth + 1);
         }
+    }
 
-        aabb box_left, box_right;
+    void build_sah(
+        std::vector<std::shared_ptr<hittable>>& objects,
+        size_t start,
+        size_t end,
+        double time0,
+        double time1,
+        const bvh_build_options& options,
+        int depth
+    ) {
+        size_t object_span = end - start;
 
-        if (!left->bounding_box(time0, time1, box_left)
-         || !right->bounding_box(time0, time1, box_right))
-            std::cerr << "No bounding box in BVH constructor.\n";
+        if (object_span == 1) {
+            left = right = objects[start];
+            return;
+        }
 
-        box = surrounding_box(box_left, box_right);
-    }
+        std::vector<aabb> boxes(object_span);
+        for (size_t i = 0; i < object_span; i++)
+            objects[start + i]->bounding_box(time0, time1, boxes[i]);
 
-    virtual bool hit(
-        const ray& r,
-        const interval& ray_t,
-        hit_record& rec
-    ) const override {
+        sah_split split = find_sah_split(
+            object_span,
+            [&](size_t i) -> const aabb& { return boxes[i]; },
+            options);
 
-        if (!box.hit(r, ray_t))
-            return false;
+        if (split.make_leaf) {
+            auto leaf = std::make_shared<hittable_list>();
+            for (size_t i = start; i < end; i++)
+                leaf->add(objects[i]);
 
-        bool hit_left =
-            left->hit(r, ray_t, rec);
+            left = right = leaf;
+            return;
+        }
 
-        bool hit_right =
-            right->hit(
-                r,
-                interval(ray_t.min,
-                         hit_left ? rec.t : ray_t.max),
-                rec
-            );
+        size_t mid = start + object_span / 2;
+
+        if (split.axis >= 0) {
+            split_axis = split.axis;
+            auto it = std::partition(
+                objects.begin() + start,
+                objects.begin() + end,
+                [&](const std::shared_ptr<hittable>& object) {
+                    aabb b;
+                    object->bounding_box(time0, time1, b);
+                    return split.goes_left(b);
+                });
+
+            mid = it - objects.begin();
+        }
 
-        return hit_left || hit_right;
+        left  = std::make_shared<bvh_node>(
+            objects, start, mid, time0, time1, options, depth + 1);
+
+        right = std::make_shared<bvh_node>(
+            objects, mid, end, time0, time1, options, depth + 1);
     }
 
-    virtual bool bounding_box(
-        double time0,
-        double time1,
-        aabb& output_box
-    ) const override {
-        output_box = box;
-        return true;
+    double subtree_cost(const bvh_build_options& options) const {
+        double area = box.surface_area();
+        double cost = options.traversal_cost * area
+                    + child_cost(left, area, options);
+
+        if (right != left)
+            cost += child_cost(right, area, options);
+
+        return cost;
     }
 
-public:
-    std::shared_ptr<hittable> left;
-    std::shared_ptr<hittable> right;
-    aabb box;
+    static double child_cost(
+        const std::shared_ptr<hittable>& child,
+        double parent_area,
+        const bvh_build_options& options
+    ) {
+        if (auto node = std::dynamic_pointer_cast<bvh_node>(child))
+            return node->subtree_cost(options);
+
+        size_t count = 1;
+        if (auto list = std::dynamic_pointer_cast<hittable_list>(child))
+            count = list->objects.size();
+
+        return options.intersection_cost * count * parent_area;
+    }
 
-private:
     static bool box_compare(
         const std::shared_ptr<hittable> a,
         const std::shared_ptr<hittable> b,
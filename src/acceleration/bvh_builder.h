@@ -0,0 +1,272 @@
+#ifndef BVH_BUILDER_H
+#define BVH_BUILDER_H
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "rtweekend.h"
+#include "aabb.h"
+#include "sah.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// One node of a flattened BVH. Nodes are stored depth-first, so the
+// first child of an interior node always follows it directly and only
+// the second child needs an explicit offset.
+struct linear_bvh_node {
+    float bounds_min[3];
+    float bounds_max[3];
+    uint32_t offset;    // first primitive (leaf) or second child (interior)
+    uint16_t count;     // primitives in the leaf, 0 for interior nodes
+    uint8_t axis;       // split axis of an interior node
+    uint8_t flags;
+
+    // The first child normally lies on the low side of the split axis.
+    // Layouts that put the other child next to its parent set this.
+    static constexpr uint8_t swapped_children = 1;
+
+    bool is_leaf() const { return count > 0; }
+    bool children_swapped() const { return flags & swapped_children; }
+
+    void set_bounds(const aabb& box) {
+        for (int a = 0; a < 3; a++) {
+            const interval& ax = box.axis_interval(a);
+            bounds_min[a] = float_down(ax.min);
+            bounds_max[a] = float_up(ax.max);
+        }
+    }
+
+    aabb bounds() const {
+        return aabb(interval(bounds_min[0], bounds_max[0]),
+                    interval(bounds_min[1], bounds_max[1]),
+                    interval(bounds_min[2], bounds_max[2]));
+    }
+
+    // Boxes are stored in single precision, rounded outwards so that
+    // the float box always contains the double one.
+    static float float_down(double v) {
+        float f = static_cast<float>(v);
+        return (f > v) ? std::nextafter(f, -INFINITY) : f;
+    }
+
+    static float float_up(double v) {
+        float f = static_cast<float>(v);
+        return (f < v) ? std::nextafter(f, INFINITY) : f;
+    }
+};
+
+static_assert(sizeof(linear_bvh_node) == 32,
+              "linear_bvh_node should stay 32 bytes");
+
+// Whether nodes read from a file form a tree traversal can walk safely:
+// every interior node's children are its successor and a later node,
+// every node but the root has exactly one parent, no path holds more
+// interior nodes than the traversal stack, and leaf_valid accepts each
+// leaf's (offset, count).
+template <typename LeafValid>
+bool linear_bvh_nodes_valid(
+    const linear_bvh_node* nodes,
+    size_t node_count,
+    LeafValid leaf_valid
+) {
+    // Parents come before their children, so one pass in index order
+    // sees each node's depth before its children need it.
+    std::vector<uint8_t> parents(node_count, 0);
+    std::vector<int> depth(node_count, 0);
+
+    for (size_t i = 0; i < node_count; i++) {
+        const auto& node = nodes[i];
+
+        if (i > 0 && parents[i] != 1)
+            return false;
+
+        if (node.is_leaf()) {
+            if (!leaf_valid(node.offset, node.count))
+                return false;
+            continue;
+        }
+
+        if (depth[i] >= bvh_stack_size
+         || node.offset <= i + 1 || node.offset >= node_count)
+            return false;
+
+        for (size_t child : {i + 1, size_t(node.offset)}) {
+            if (parents[child]++ != 0)
+                return false;
+            depth[child] = depth[i] + 1;
+        }
+    }
+
+    return true;
+}
+
+// Builds a flattened BVH over primitive boxes. The resulting `indices`
+// list the primitives in leaf order; a leaf covers
+// indices[offset, offset + count).
+class bvh_builder {
+public:
+    std::vector<linear_bvh_node> nodes;
+    std::vector<uint32_t> indices;
+
+    bvh_builder(
+        const std::vector<aabb>& prim_boxes,
+        const bvh_build_options& build_options
+    ) : boxes(prim_boxes), options(build_options) {
+
+        options.max_leaf_size =
+            std::min<size_t>(std::max<size_t>(options.max_leaf_size, 1),
+                             UINT16_MAX);
+
+        indices.resize(boxes.size());
+        for (size_t i = 0; i < indices.size(); i++)
+            indices[i] = static_cast<uint32_t>(i);
+
+        if (boxes.empty())
+            return;
+
+        nodes.reserve(2 * boxes.size());
+
+#ifdef _OPENMP
+        if (options.parallel && !omp_in_parallel()) {
+            #pragma omp parallel
+            {
+                #pragma omp single
+                build(0, boxes.size(), 0, nodes);
+            }
+            return;
+        }
+#endif
+
+        build(0, boxes.size(), 0, nodes);
+    }
+
+private:
+    const std::vector<aabb>& boxes;
+    bvh_build_options options;
+
+    uint32_t build(
+        size_t start,
+        size_t end,
+        int depth,
+        std::vector<linear_bvh_node>& out
+    ) {
+        uint32_t index = static_cast<uint32_t>(out.size());
+        out.emplace_back();
+
+        aabb bounds = empty_box();
+        for (size_t i = start; i < end; i++)
+            bounds = surrounding_box(bounds, boxes[indices[i]]);
+
+        out[index].set_bounds(bounds);
+
+        size_t count = end - start;
+        size_t mid = start + count / 2;
+        int axis = 0;
+
+        if (count == 1) {
+            make_leaf(out[index], start, count);
+            return index;
+        }
+
+        if (options.split == bvh_split_method::sah
+         && depth < bvh_median_depth) {
+
+            sah_split split = find_sah_split(
+                count,
+                [&](size_t i) -> const aabb& {
+                    return boxes[indices[start + i]];
+                },
+                options);
+
+            if (split.make_leaf) {
+                make_leaf(out[index], start, count);
+                return index;
+            }
+
+            if (split.axis >= 0) {
+                axis = split.axis;
+                auto it = std::partition(
+                    indices.begin() + start,
+                    indices.begin() + end,
+                    [&](uint32_t p) { return split.goes_left(boxes[p]); });
+
+                mid = it - indices.begin();
+            }
+        }
+        else {
+            if (count <= options.max_leaf_size) {
+                make_leaf(out[index], start, count);
+                return index;
+            }
+
+            axis = median_split(start, end);
+        }
+
+        out[index].axis = static_cast<uint8_t>(axis);
+
+        if (options.parallel && count >= options.parallel_grain) {
+            // The right subtree is built into its own array by another
+            // task, then appended with its child offsets rebased.
+            std::vector<linear_bvh_node> right_nodes;
+
+            #pragma omp task shared(right_nodes)
+            build(mid, end, depth + 1, right_nodes);
+
+            build(start, mid, depth + 1, out);
+
+            #pragma omp taskwait
+
+            uint32_t base = static_cast<uint32_t>(out.size());
+            for (auto node : right_nodes) {
+                if (!node.is_leaf())
+                    node.offset += base;
+                out.push_back(node);
+            }
+
+            out[index].offset = base;
+            return index;
+        }
+
+        build(start, mid, depth + 1, out);
+        out[index].offset = build(mid, end, depth + 1, out);
+
+        return index;
+    }
+
+    static void make_leaf(linear_bvh_node& node, size_t start, size_t count) {
+        node.offset = static_cast<uint32_t>(start);
+        node.count = static_cast<uint16_t>(count);
+    }
+
+    // Splits at the centroid median along the widest centroid axis.
+    int median_split(size_t start, size_t end) {
+        aabb centroid_bounds = empty_box();
+        for (size_t i = start; i < end; i++) {
+            point3 c = boxes[indices[i]].centroid();
+            centroid_bounds = surrounding_box(centroid_bounds, aabb(c, c));
+        }
+
+        int axis = 0;
+        for (int a = 1; a < 3; a++) {
+            if (centroid_bounds.axis_interval(a).size()
+              > centroid_bounds.axis_interval(axis).size())
+                axis = a;
+        }
+
+        std::nth_element(
+            indices.begin() + start,
+            indices.begin() + start + (end - start) / 2,
+            indices.begin() + end,
+            [&](uint32_t a, uint32_t b) {
+                return boxes[a].centroid()[axis]
+                     < boxes[b].centroid()[axis];
+            });
+
+        return axis;
+    }
+};
+
+#endif
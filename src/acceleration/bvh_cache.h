@@ -0,0 +1,244 @@
+#ifndef BVH_CACHE_H
+#define BVH_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "rtweekend.h"
+#include "hittable_list.h"
+#include "linear_bvh.h"
+#include "mapped_file.h"
+
+// On-disk cache of built linear_bvh trees. A file holds a header, the
+// node array exactly as it sits in memory, and for every primitive slot
+// the index of its object in the scene list. Files are named by a hash
+// of everything that decides the tree: the object boxes, whether they
+// may be split, the shutter interval and the build options. A scene
+// with the same geometry therefore finds its tree again however it is
+// lit, shaded or viewed.
+struct bvh_cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t node_size;
+    uint64_t geometry_hash;
+    uint64_t node_count;
+    uint64_t primitive_count;
+};
+
+constexpr char bvh_cache_magic[8] = {'R', 'T', 'B', 'V', 'H', 'C', 'A', 'C'};
+constexpr uint32_t bvh_cache_version = 1;
+
+// 64-bit FNV-1a, fed field by field.
+class bvh_hasher {
+public:
+    template <typename T>
+    void add(const T& value) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        for (size_t i = 0; i < sizeof(T); i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+    }
+
+    uint64_t value() const { return hash; }
+
+private:
+    uint64_t hash = 0xcbf29ce484222325ull;
+};
+
+inline uint64_t bvh_geometry_hash(
+    const hittable_list& list,
+    double time0,
+    double time1,
+    const bvh_build_options& options
+) {
+    bvh_hasher h;
+
+    h.add(bvh_cache_version);
+    h.add(time0);
+    h.add(time1);
+
+    h.add(options.split);
+    h.add(options.sah_bins);
+    h.add(options.traversal_cost);
+    h.add(options.intersection_cost);
+    h.add(options.max_leaf_size);
+    h.add(options.spatial_splits);
+    h.add(options.spatial_split_alpha);
+    h.add(options.max_duplication);
+    h.add(options.layout);
+    h.add(options.treelet_bytes);
+
+    h.add(list.objects.size());
+
+    for (const auto& object : list.objects) {
+        aabb box;
+        if (object->bounding_box(time0, time1, box)) {
+            for (int a = 0; a < 3; a++) {
+                h.add(box.axis_interval(a).min);
+                h.add(box.axis_interval(a).max);
+            }
+        }
+        h.add(object->is_stochastic());
+    }
+
+    return h.value();
+}
+
+// Writes `bvh`, built over `list`, to `path`. The file is written under
+// a temporary name and renamed, so readers never see a partial one.
+inline bool save_bvh_cache(
+    const linear_bvh& bvh,
+    const hittable_list& list,
+    uint64_t geometry_hash,
+    const std::filesystem::path& path
+) {
+    std::unordered_map<const hittable*, uint32_t> index_of;
+    for (size_t i = 0; i < list.objects.size(); i++)
+        index_of.emplace(list.objects[i].get(), static_cast<uint32_t>(i));
+
+    std::vector<uint32_t> indices;
+    indices.reserve(bvh.primitives.size());
+
+    for (const auto& object : bvh.primitives) {
+        auto it = index_of.find(object.get());
+        if (it == index_of.end())
+            return false;
+        indices.push_back(it->second);
+    }
+
+    bvh_cache_header header = {};
+    std::memcpy(header.magic, bvh_cache_magic, sizeof(header.magic));
+    header.version = bvh_cache_version;
+    header.node_size = sizeof(linear_bvh_node);
+    header.geometry_hash = geometry_hash;
+    header.node_count = bvh.nodes.size();
+    header.primitive_count = indices.size();
+
+    std::filesystem::path temp = path;
+    temp += ".tmp";
+
+    {
+        std::ofstream out(temp, std::ios::binary);
+        if (!out)
+            return false;
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(bvh.nodes.data()),
+                  bvh.nodes.size() * sizeof(linear_bvh_node));
+        out.write(reinterpret_cast<const char*>(indices.data()),
+                  indices.size() * sizeof(uint32_t));
+
+        if (!out)
+            return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp, path, error);
+    return !error;
+}
+
+// Reads a tree saved for the same geometry. Returns nullptr when the
+// file is missing, was written for other geometry or another node
+// format, or does not describe a well-formed tree over `list`.
+inline std::shared_ptr<linear_bvh> load_bvh_cache(
+    const hittable_list& list,
+    uint64_t geometry_hash,
+    const std::filesystem::path& path,
+    double time0,
+    double time1,
+    const bvh_build_options& options
+) {
+    mapped_file file(path);
+    if (!file.data() || file.size() < sizeof(bvh_cache_header))
+        return nullptr;
+
+    bvh_cache_header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, bvh_cache_magic, sizeof(header.magic)) != 0
+     || header.version != bvh_cache_version
+     || header.node_size != sizeof(linear_bvh_node)
+     || header.geometry_hash != geometry_hash)
+        return nullptr;
+
+    // Bound the counts first so a crafted header cannot wrap the sizes.
+    if (header.node_count > file.size() / sizeof(linear_bvh_node)
+     || header.primitive_count > file.size() / sizeof(uint32_t))
+        return nullptr;
+
+    const size_t node_bytes = header.node_count * sizeof(linear_bvh_node);
+    const size_t index_bytes = header.primitive_count * sizeof(uint32_t);
+
+    if (file.size() != sizeof(header) + node_bytes + index_bytes)
+        return nullptr;
+
+    std::vector<linear_bvh_node> nodes(header.node_count);
+    std::memcpy(nodes.data(), file.data() + sizeof(header), node_bytes);
+
+    std::vector<uint32_t> indices(header.primitive_count);
+    std::memcpy(indices.data(), file.data() + sizeof(header) + node_bytes, index_bytes);
+
+    // Hash collisions and stale files must not crash traversal.
+    auto leaf_valid = [&](uint32_t offset, uint32_t count) {
+        return size_t(offset) + count <= indices.size();
+    };
+
+    if (!linear_bvh_nodes_valid(nodes.data(), nodes.size(), leaf_valid))
+        return nullptr;
+
+    std::vector<std::shared_ptr<hittable>> primitives;
+    primitives.reserve(indices.size());
+
+    for (auto i : indices) {
+        if (i >= list.objects.size())
+            return nullptr;
+        primitives.push_back(list.objects[i]);
+    }
+
+    return std::make_shared<linear_bvh>(
+        std::move(nodes), std::move(primitives), time0, time1, options);
+}
+
+// Loads the tree for this geometry from cache_dir, or builds it and
+// stores it there for the next run.
+inline std::shared_ptr<linear_bvh> cached_linear_bvh(
+    const hittable_list& list,
+    double time0,
+    double time1,
+    const bvh_build_options& options,
+    const std::filesystem::path& cache_dir,
+    bool* loaded = nullptr
+) {
+    uint64_t hash = bvh_geometry_hash(list, time0, time1, options);
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "bvh_%016llx.bin",
+                  static_cast<unsigned long long>(hash));
+    std::filesystem::path path = cache_dir / name;
+
+    auto bvh = load_bvh_cache(list, hash, path, time0, time1, options);
+
+    if (loaded)
+        *loaded = bvh != nullptr;
+
+    if (bvh)
+        return bvh;
+
+    bvh = std::make_shared<linear_bvh>(list, time0, time1, options);
+
+    std::error_code error;
+    std::filesystem::create_directories(cache_dir, error);
+    if (error || !save_bvh_cache(*bvh, list, hash, path))
+        std::cerr << "Could not write BVH cache " << path << "\n";
+
+    return bvh;
+}
+
+#endif
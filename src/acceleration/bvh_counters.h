@@ -0,0 +1,86 @@
+#ifndef BVH_COUNTERS_H
+#define BVH_COUNTERS_H
+
+#include <atomic>
+#include <cstdint>
+
+// Traversal counters for judging BVH quality during a render. They are
+// compiled in only with RT_BVH_STATS; otherwise RT_BVH_COUNT expands to
+// nothing and traversal pays no cost.
+//
+// Binary BVHs count leaves as visited nodes; wide BVHs keep leaves in
+// their parent's child slots and count interior nodes only.
+//
+// sdf_hittable adds its sphere-tracing work: marches started, distance
+// evaluations taken, and marches that ran out of steps before finding
+// the surface or leaving the bounds.
+struct bvh_ray_counters {
+    uint64_t rays = 0;
+    uint64_t nodes_visited = 0;
+    uint64_t primitives_tested = 0;
+    uint64_t sdf_marches = 0;
+    uint64_t sdf_steps = 0;
+    uint64_t sdf_exhausted = 0;
+};
+
+#ifdef RT_BVH_STATS
+
+inline bvh_ray_counters& bvh_thread_counters() {
+    thread_local bvh_ray_counters counters;
+    return counters;
+}
+
+#define RT_BVH_COUNT(field, n) (bvh_thread_counters().field += (n))
+
+#else
+
+#define RT_BVH_COUNT(field, n) ((void)0)
+
+#endif
+
+struct bvh_counter_totals {
+    std::atomic<uint64_t> rays{0};
+    std::atomic<uint64_t> nodes_visited{0};
+    std::atomic<uint64_t> primitives_tested{0};
+    std::atomic<uint64_t> sdf_marches{0};
+    std::atomic<uint64_t> sdf_steps{0};
+    std::atomic<uint64_t> sdf_exhausted{0};
+};
+
+inline bvh_counter_totals& bvh_render_totals() {
+    static bvh_counter_totals totals;
+    return totals;
+}
+
+// Moves the calling thread's counts into the render totals. Render
+// loops call this once per row so the atomics are rarely touched.
+inline void bvh_flush_counters() {
+#ifdef RT_BVH_STATS
+    bvh_ray_counters& local = bvh_thread_counters();
+    bvh_counter_totals& totals = bvh_render_totals();
+
+    totals.rays += local.rays;
+    totals.nodes_visited += local.nodes_visited;
+    totals.primitives_tested += local.primitives_tested;
+    totals.sdf_marches += local.sdf_marches;
+    totals.sdf_steps += local.sdf_steps;
+    totals.sdf_exhausted += local.sdf_exhausted;
+
+    local = bvh_ray_counters();
+#endif
+}
+
+inline bvh_ray_counters bvh_counters_total() {
+    const bvh_counter_totals& totals = bvh_render_totals();
+
+    bvh_ray_counters result;
+    result.rays = totals.rays;
+    result.nodes_visited = totals.nodes_visited;
+    result.primitives_tested = totals.primitives_tested;
+    result.sdf_marches = totals.sdf_marches;
+    result.sdf_steps = totals.sdf_steps;
+    result.sdf_exhausted = totals.sdf_exhausted;
+    return result;
+}
+
+#endif
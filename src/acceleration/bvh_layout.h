@@ -0,0 +1,154 @@
+#ifndef BVH_LAYOUT_H
+#define BVH_LAYOUT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "rtweekend.h"
+#include "sah.h"
+#include "bvh_builder.h"
+
+// Rewrites a flattened BVH in the given layout. Topology and leaf
+// ranges are unchanged; only node order, second-child offsets and the
+// swapped_children flags differ. Children still follow their parents,
+// so bottom-up refits keep working on the result.
+class bvh_layout_builder {
+public:
+    std::vector<linear_bvh_node> nodes;
+
+    bvh_layout_builder(
+        const std::vector<linear_bvh_node>& source_nodes,
+        bvh_layout layout,
+        size_t treelet_bytes
+    ) : source(source_nodes), layout(layout) {
+
+        if (source.empty())
+            return;
+
+        treelet_nodes = SIZE_MAX;
+        if (layout == bvh_layout::treelet)
+            treelet_nodes = std::max<size_t>(treelet_bytes / sizeof(linear_bvh_node), 1);
+
+        treelet_of.assign(source.size(), UINT32_MAX);
+        placed.assign(source.size(), UINT32_MAX);
+        nodes.reserve(source.size());
+
+        pending.push_back(0);
+        uint32_t treelet = 0;
+
+        while (!pending.empty()) {
+            uint32_t root = pending.front();
+            pending.pop_front();
+
+            gather_treelet(root, treelet);
+            emit(root, treelet);
+            treelet++;
+        }
+
+        for (const auto& patch : patches)
+            nodes[patch.first].offset = placed[patch.second];
+    }
+
+private:
+    const std::vector<linear_bvh_node>& source;
+    bvh_layout layout;
+    size_t treelet_nodes = SIZE_MAX;
+
+    std::vector<uint32_t> treelet_of;
+    std::vector<uint32_t> placed;       // new index of each source node
+    std::deque<uint32_t> pending;       // roots of treelets still to emit
+
+    // (new node, source child): second-child offsets resolved once the
+    // child's treelet has been emitted.
+    std::vector<std::pair<uint32_t, uint32_t>> patches;
+
+    uint32_t low_child(uint32_t i) const {
+        const auto& node = source[i];
+        return node.children_swapped() ? node.offset : i + 1;
+    }
+
+    uint32_t high_child(uint32_t i) const {
+        const auto& node = source[i];
+        return node.children_swapped() ? i + 1 : node.offset;
+    }
+
+    double area(uint32_t i) const {
+        return source[i].bounds().surface_area();
+    }
+
+    // The child stored directly after its parent.
+    uint32_t adjacent_child(uint32_t i) const {
+        uint32_t low = low_child(i);
+        uint32_t high = high_child(i);
+
+        if (layout == bvh_layout::depth_first)
+            return low;
+
+        return area(high) > area(low) ? high : low;
+    }
+
+    uint32_t other_child(uint32_t i) const {
+        uint32_t a = adjacent_child(i);
+        return a == low_child(i) ? high_child(i) : low_child(i);
+    }
+
+    // Grows a treelet from `root` by repeatedly adding the frontier node
+    // with the largest surface area. Adding a node adds its whole chain
+    // of adjacent children down to a leaf, since each of them must be
+    // stored right after its parent.
+    void gather_treelet(uint32_t root, uint32_t treelet) {
+        std::priority_queue<std::pair<double, uint32_t>> frontier;
+        frontier.push({area(root), root});
+        size_t size = 0;
+
+        while (!frontier.empty() && size < treelet_nodes) {
+            uint32_t i = frontier.top().second;
+            frontier.pop();
+
+            while (true) {
+                treelet_of[i] = treelet;
+                size++;
+
+                if (source[i].is_leaf())
+                    break;
+
+                uint32_t other = other_child(i);
+                frontier.push({area(other), other});
+                i = adjacent_child(i);
+            }
+        }
+    }
+
+    uint32_t emit(uint32_t i, uint32_t treelet) {
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(source[i]);
+        placed[i] = index;
+
+        if (source[i].is_leaf())
+            return index;
+
+        uint32_t adjacent = adjacent_child(i);
+        uint32_t other = other_child(i);
+
+        nodes[index].flags = (adjacent == low_child(i))
+            ? nodes[index].flags & ~linear_bvh_node::swapped_children
+            : nodes[index].flags | linear_bvh_node::swapped_children;
+
+        emit(adjacent, treelet);
+
+        if (treelet_of[other] == treelet) {
+            uint32_t other_index = emit(other, treelet);
+            nodes[index].offset = other_index;
+        } else {
+            pending.push_back(other);
+            patches.push_back({index, other});
+        }
+
+        return index;
+    }
+};
+
+#endif
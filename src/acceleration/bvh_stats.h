@@ -0,0 +1,189 @@
+#ifndef BVH_STATS_H
+#define BVH_STATS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "rtweekend.h"
+#include "bvh.h"
+#include "linear_bvh.h"
+
+// Shape and quality metrics of a built BVH, for comparing builders.
+struct bvh_stats {
+    size_t node_count = 0;
+    size_t interior_count = 0;
+    size_t leaf_count = 0;
+    size_t references = 0;          // primitive slots over all leaves
+
+    int max_depth = 0;
+    double average_leaf_depth = 0;
+
+    size_t min_leaf_size = 0;
+    size_t max_leaf_size = 0;
+    double average_leaf_size = 0;
+    std::vector<size_t> leaf_size_histogram;    // [n] = leaves holding n
+
+    // Mean over interior nodes of the children's overlap area divided
+    // by the parent's area; 0 for disjoint children.
+    double average_overlap = 0;
+
+    double sah_cost = 0;
+    size_t memory_bytes = 0;
+
+    void print(std::ostream& out) const {
+        out << "BVH stats:\n"
+            << "  nodes:       " << node_count << " ("
+            << interior_count << " interior, " << leaf_count << " leaves)\n"
+            << "  references:  " << references << "\n"
+            << "  depth:       max " << max_depth
+            << ", average leaf " << average_leaf_depth << "\n"
+            << "  leaf size:   min " << min_leaf_size
+            << ", max " << max_leaf_size
+            << ", average " << average_leaf_size << "\n"
+            << "  overlap:     " << average_overlap << "\n"
+            << "  SAH cost:    " << sah_cost << "\n"
+            << "  memory:      " << memory_bytes << " bytes\n"
+            << "  leaf sizes: ";
+
+        for (size_t n = 1; n < leaf_size_histogram.size(); n++) {
+            if (leaf_size_histogram[n] > 0)
+                out << " " << n << ":" << leaf_size_histogram[n];
+        }
+
+        out << "\n";
+    }
+};
+
+inline double overlap_area(const aabb& a, const aabb& b) {
+    double dx = fmin(a.x.max, b.x.max) - fmax(a.x.min, b.x.min);
+    double dy = fmin(a.y.max, b.y.max) - fmax(a.y.min, b.y.min);
+    double dz = fmin(a.z.max, b.z.max) - fmax(a.z.min, b.z.min);
+
+    if (dx < 0 || dy < 0 || dz < 0)
+        return 0.0;
+
+    return 2.0 * (dx*dy + dy*dz + dz*dx);
+}
+
+inline bvh_stats compute_bvh_stats(
+    const linear_bvh& bvh,
+    const bvh_build_options& options = bvh_build_options()
+) {
+    bvh_stats stats;
+    const auto& nodes = bvh.nodes;
+
+    stats.node_count = nodes.size();
+    stats.memory_bytes = bvh.memory_bytes();
+    stats.sah_cost = bvh.sah_cost(options);
+
+    if (nodes.empty())
+        return stats;
+
+    stats.min_leaf_size = SIZE_MAX;
+
+    struct entry {
+        uint32_t index;
+        int depth;
+    };
+
+    std::vector<entry> stack = { {0, 0} };
+    double depth_sum = 0;
+    double overlap_sum = 0;
+
+    while (!stack.empty()) {
+        entry e = stack.back();
+        stack.pop_back();
+
+        const linear_bvh_node& node = nodes[e.index];
+        stats.max_depth = std::max(stats.max_depth, e.depth);
+
+        if (node.is_leaf()) {
+            stats.leaf_count++;
+            stats.references += node.count;
+            depth_sum += e.depth;
+
+            stats.min_leaf_size = std::min<size_t>(stats.min_leaf_size, node.count);
+            stats.max_leaf_size = std::max<size_t>(stats.max_leaf_size, node.count);
+
+            if (stats.leaf_size_histogram.size() <= node.count)
+                stats.leaf_size_histogram.resize(node.count + 1);
+            stats.leaf_size_histogram[node.count]++;
+            continue;
+        }
+
+        stats.interior_count++;
+
+        double parent_area = node.bounds().surface_area();
+        if (parent_area > 0) {
+            overlap_sum += overlap_area(nodes[e.index + 1].bounds(),
+                                        nodes[node.offset].bounds())
+                         / parent_area;
+        }
+
+        stack.push_back({e.index + 1, e.depth + 1});
+        stack.push_back({node.offset, e.depth + 1});
+    }
+
+    stats.average_leaf_depth = depth_sum / stats.leaf_count;
+    stats.average_leaf_size =
+        static_cast<double>(stats.references) / stats.leaf_count;
+
+    if (stats.interior_count > 0)
+        stats.average_overlap = overlap_sum / stats.interior_count;
+
+    return stats;
+}
+
+// A pointer-based tree is measured through its flattened form, which
+// keeps the same topology. Memory is reported for the flattened copy.
+inline bvh_stats compute_bvh_stats(
+    const bvh_node& root,
+    double time0,
+    double time1,
+    const bvh_build_options& options = bvh_build_options()
+) {
+    return compute_bvh_stats(linear_bvh(root, time0, time1), options);
+}
+
+// Writes one line per node, indented by depth: its box, and either the
+// split axis or the primitive range it covers.
+inline void dump_bvh(const linear_bvh& bvh, std::ostream& out) {
+    const auto& nodes = bvh.nodes;
+
+    struct entry {
+        uint32_t index;
+        int depth;
+    };
+
+    std::vector<entry> stack;
+    if (!nodes.empty())
+        stack.push_back({0, 0});
+
+    while (!stack.empty()) {
+        entry e = stack.back();
+        stack.pop_back();
+
+        const linear_bvh_node& node = nodes[e.index];
+
+        out << std::string(2 * e.depth, ' ') << e.index << " ["
+            << node.bounds_min[0] << " " << node.bounds_min[1] << " "
+            << node.bounds_min[2] << "] - ["
+            << node.bounds_max[0] << " " << node.bounds_max[1] << " "
+            << node.bounds_max[2] << "]";
+
+        if (node.is_leaf()) {
+            out << " leaf " << node.offset << "+" << node.count << "\n";
+            continue;
+        }
+
+        out << " split " << "xyz"[node.axis] << "\n";
+
+        // Second child pushed first so the first child prints next.
+        stack.push_back({node.offset, e.depth + 1});
+        stack.push_back({e.index + 1, e.depth + 1});
+    }
+}
+
+#endif
@@ -0,0 +1,497 @@
+#ifndef LINEAR_BVH_H
+#define LINEAR_BVH_H
+
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "rtweekend.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "bvh.h"
+#include "bvh_builder.h"
+#include "sbvh_builder.h"
+#include "bvh_counters.h"
+#include "bvh_layout.h"
+
+// Slab test against a flattened node. On a hit, t_enter receives the
+// distance at which the ray enters the box (clipped to ray_t).
+inline bool node_hit(
+    const linear_bvh_node& node,
+    const ray& r,
+    interval ray_t,
+    double& t_enter
+) {
+    const point3& origin = r.origin();
+    const vec3& inv_dir = r.inv_direction();
+
+    for (int axis = 0; axis < 3; axis++) {
+        const int neg = r.sign(axis);
+        const float* entry_face = neg ? node.bounds_max : node.bounds_min;
+        const float* exit_face  = neg ? node.bounds_min : node.bounds_max;
+
+        auto t0 = (entry_face[axis] - origin[axis]) * inv_dir[axis];
+        auto t1 = (exit_face[axis] - origin[axis]) * inv_dir[axis];
+
+        ray_t.min = t0 > ray_t.min ? t0 : ray_t.min;
+        ray_t.max = t1 < ray_t.max ? t1 : ray_t.max;
+    }
+
+    t_enter = ray_t.min;
+    return ray_t.min < ray_t.max;
+}
+
+// Walks a flattened BVH with an explicit stack. leaf_hit(first, count,
+// ray_t) tests one leaf and must shrink ray_t.max to the closest hit it
+// finds, returning whether it found one. With AnyHit set the walk stops
+// at the first leaf that reports a hit.
+//
+// Both children's boxes are tested at their parent. The child on the
+// ray's side of the split axis is visited first; the other is pushed
+// with its entry distance and dropped on pop if a closer hit was found.
+// Any node type with a matching node_hit overload can be walked, held
+// in any indexable array.
+template <bool AnyHit = false, typename Nodes, typename LeafHit>
+bool traverse_linear_bvh(
+    const Nodes& nodes,
+    const ray& r,
+    interval ray_t,
+    LeafHit leaf_hit
+) {
+    using Node = typename Nodes::value_type;
+
+    if (nodes.empty())
+        return false;
+
+    struct entry {
+        uint32_t index;
+        double t_enter;
+    };
+
+    entry stack[bvh_stack_size];
+    int stack_top = 0;
+    bool hit_anything = false;
+
+    double t_root;
+    if (!node_hit(nodes[0], r, ray_t, t_root))
+        return false;
+
+    uint32_t current = 0;
+
+    while (true) {
+        const Node& node = nodes[current];
+        RT_BVH_COUNT(nodes_visited, 1);
+
+        if (node.is_leaf()) {
+            RT_BVH_COUNT(primitives_tested, node.count);
+            if (leaf_hit(node.offset, node.count, ray_t)) {
+                if (AnyHit)
+                    return true;
+                hit_anything = true;
+            }
+        }
+        else {
+            uint32_t near = current + 1;
+            uint32_t far = node.offset;
+            if (r.sign(node.axis) != node.children_swapped())
+                std::swap(near, far);
+
+            double t_near, t_far;
+            bool hit_near = node_hit(nodes[near], r, ray_t, t_near);
+            bool hit_far = node_hit(nodes[far], r, ray_t, t_far);
+
+            if (hit_near) {
+                if (hit_far)
+                    stack[stack_top++] = {far, t_far};
+                current = near;
+                continue;
+            }
+
+            if (hit_far) {
+                current = far;
+                continue;
+            }
+        }
+
+        bool found = false;
+        while (stack_top > 0) {
+            const entry& e = stack[--stack_top];
+            if (e.t_enter < ray_t.max) {
+                current = e.index;
+                found = true;
+                break;
+            }
+        }
+
+        if (!found)
+            break;
+    }
+
+    return hit_anything;
+}
+
+// Flattened BVH over shared hittables: one contiguous node array and
+// one primitive array, with no per-node heap allocation.
+class linear_bvh : public hittable {
+public:
+    linear_bvh() {}
+
+    linear_bvh(
+        const hittable_list& list,
+        double _time0,
+        double _time1,
+        const bvh_build_options& _options = bvh_build_options()
+    ) : time0(_time0), time1(_time1), options(_options) {
+        std::vector<aabb> boxes(list.objects.size());
+        const long count = static_cast<long>(boxes.size());
+
+        #pragma omp parallel for if(options.parallel)
+        for (long i = 0; i < count; i++) {
+            if (!list.objects[i]->bounding_box(time0, time1, boxes[i]))
+                std::cerr << "No bounding box in linear_bvh constructor.\n";
+        }
+
+        std::vector<uint32_t> order;
+
+        if (options.spatial_splits) {
+            std::vector<bool> splittable(boxes.size());
+            for (size_t i = 0; i < boxes.size(); i++)
+                splittable[i] = !list.objects[i]->is_stochastic();
+
+            sbvh_builder builder(boxes, splittable, options);
+            nodes = std::move(builder.nodes);
+            order = std::move(builder.indices);
+        } else {
+            bvh_builder builder(boxes, options);
+            nodes = std::move(builder.nodes);
+            order = std::move(builder.indices);
+        }
+
+        primitives.reserve(order.size());
+        for (auto i : order)
+            primitives.push_back(list.objects[i]);
+
+        if (!nodes.empty())
+            box = nodes[0].bounds();
+
+        if (options.layout != bvh_layout::depth_first)
+            reorder(options.layout, options.treelet_bytes);
+
+        built_cost = refitted_cost();
+    }
+
+    // Adopts nodes and primitives built elsewhere, such as a tree read
+    // back by load_bvh_cache.
+    linear_bvh(
+        std::vector<linear_bvh_node> _nodes,
+        std::vector<std::shared_ptr<hittable>> _primitives,
+        double _time0,
+        double _time1,
+        const bvh_build_options& _options = bvh_build_options()
+    ) : nodes(std::move(_nodes)),
+        primitives(std::move(_primitives)),
+        time0(_time0),
+        time1(_time1),
+        options(_options) {
+
+        if (!nodes.empty())
+            box = nodes[0].bounds();
+
+        built_cost = refitted_cost();
+    }
+
+    // Flattens an existing pointer-based tree, keeping its topology.
+    linear_bvh(const bvh_node& root, double _time0, double _time1)
+        : time0(_time0), time1(_time1) {
+        flatten(root);
+        box = root.box;
+        built_cost = sah_cost(options);
+    }
+
+    virtual bool hit(
+        const ray& r,
+        const interval& ray_t,
+        hit_record& rec
+    ) const override {
+
+        return traverse_linear_bvh(nodes, r, ray_t,
+            [&](uint32_t first, uint32_t count, interval& t) {
+                bool hit_leaf = false;
+
+                for (uint32_t i = first; i < first + count; i++) {
+                    if (primitives[i]->hit(r, t, rec)) {
+                        hit_leaf = true;
+                        t.max = rec.t;
+                    }
+                }
+
+                return hit_leaf;
+            });
+    }
+
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+
+        return traverse_linear_bvh<true>(nodes, r, ray_t,
+            [&](uint32_t first, uint32_t count, interval& t) {
+                for (uint32_t i = first; i < first + count; i++) {
+                    if (primitives[i]->occluded(r, t))
+                        return true;
+                }
+
+                return false;
+            });
+    }
+
+    virtual bool bounding_box(
+        double time0,
+        double time1,
+        aabb& output_box
+    ) const override {
+        if (nodes.empty())
+            return false;
+
+        output_box = box;
+        return true;
+    }
+
+    size_t node_count() const { return nodes.size(); }
+
+    size_t memory_bytes() const {
+        return nodes.size() * sizeof(linear_bvh_node)
+             + primitives.size() * sizeof(std::shared_ptr<hittable>);
+    }
+
+    // Standard SAH estimate: traversal cost for every interior node and
+    // intersection cost per primitive for every leaf, weighted by box
+    // area relative to the root.
+    double sah_cost(
+        const bvh_build_options& options = bvh_build_options()
+    ) const {
+        if (nodes.empty())
+            return 0.0;
+
+        double cost = 0.0;
+        for (const auto& node : nodes) {
+            double area = node.bounds().surface_area();
+            cost += node.is_leaf()
+                ? options.intersection_cost * node.count * area
+                : options.traversal_cost * area;
+        }
+
+        return cost / nodes[0].bounds().surface_area();
+    }
+
+    // Lays the nodes out again in the given order, and the primitives
+    // in the order their leaves now appear.
+    void reorder(bvh_layout layout, size_t treelet_bytes = 4096) {
+        bvh_layout_builder builder(nodes, layout, treelet_bytes);
+        nodes = std::move(builder.nodes);
+
+        std::vector<std::shared_ptr<hittable>> ordered;
+        ordered.reserve(primitives.size());
+
+        for (auto& node : nodes) {
+            if (!node.is_leaf())
+                continue;
+
+            uint32_t first = static_cast<uint32_t>(ordered.size());
+            for (uint32_t p = node.offset; p < node.offset + node.count; p++)
+                ordered.push_back(primitives[p]);
+            node.offset = first;
+        }
+
+        primitives = std::move(ordered);
+
+        parents.clear();
+        leaves_of.clear();
+    }
+
+    // Recomputes every node box bottom-up for the primitives' current
+    // positions over [_time0, _time1], keeping the topology. Children
+    // always sit after their parent, so one reverse sweep suffices.
+    void refit(double _time0, double _time1) {
+        time0 = _time0;
+        time1 = _time1;
+
+        for (size_t i = nodes.size(); i-- > 0;)
+            refit_node(static_cast<uint32_t>(i));
+
+        if (!nodes.empty())
+            box = nodes[0].bounds();
+    }
+
+    // Refits only the leaves holding the given primitives and their
+    // ancestors, stopping early where a box does not change.
+    void refit(const std::vector<std::shared_ptr<hittable>>& moved) {
+        if (nodes.empty())
+            return;
+
+        if (parents.empty())
+            index_topology();
+
+        for (const auto& object : moved) {
+            auto range = leaves_of.equal_range(object.get());
+
+            for (auto it = range.first; it != range.second; ++it) {
+                uint32_t i = it->second;
+
+                while (refit_node(i) && i != 0)
+                    i = parents[i];
+            }
+        }
+
+        box = nodes[0].bounds();
+    }
+
+    // Full refit followed by a rebuild from scratch when the SAH cost
+    // has grown past max_cost_ratio times its value after the last
+    // build. Returns whether it rebuilt.
+    bool refit_or_rebuild(
+        double _time0,
+        double _time1,
+        double max_cost_ratio = 1.5
+    ) {
+        refit(_time0, _time1);
+
+        if (sah_cost(options) <= max_cost_ratio * built_cost)
+            return false;
+
+        // Spatial splits may reference an object from several leaves;
+        // rebuild from each object once.
+        hittable_list list;
+        std::unordered_set<const hittable*> seen;
+        for (const auto& object : primitives) {
+            if (seen.insert(object.get()).second)
+                list.add(object);
+        }
+
+        *this = linear_bvh(list, time0, time1, options);
+
+        return true;
+    }
+
+public:
+    std::vector<linear_bvh_node> nodes;
+    std::vector<std::shared_ptr<hittable>> primitives;
+    aabb box;
+
+private:
+    double time0 = 0;
+    double time1 = 0;
+    bvh_build_options options;
+    double built_cost = 0;
+
+    // Built on the first partial refit.
+    std::vector<uint32_t> parents;
+    std::unordered_multimap<const hittable*, uint32_t> leaves_of;
+
+    // The cost refit_or_rebuild compares against. Spatial splits clip
+    // leaf boxes to part of a primitive's box, which refit_node cannot
+    // do, so a refit of such a tree starts out looser than it was built;
+    // its baseline is the cost of the unchanged tree after a refit.
+    double refitted_cost() const {
+        if (!options.spatial_splits)
+            return sah_cost(options);
+
+        linear_bvh refitted = *this;
+        refitted.refit(time0, time1);
+        return refitted.sah_cost(options);
+    }
+
+    // Returns whether the node's box changed.
+    bool refit_node(uint32_t i) {
+        linear_bvh_node& node = nodes[i];
+        aabb b = empty_box();
+
+        if (node.is_leaf()) {
+            for (uint32_t p = node.offset; p < node.offset + node.count; p++) {
+                aabb prim_box;
+                if (primitives[p]->bounding_box(time0, time1, prim_box))
+                    b = surrounding_box(b, prim_box);
+            }
+        } else {
+            b = surrounding_box(nodes[i + 1].bounds(),
+                                nodes[node.offset].bounds());
+        }
+
+        linear_bvh_node before = node;
+        node.set_bounds(b);
+
+        return std::memcmp(before.bounds_min, node.bounds_min,
+                           sizeof(node.bounds_min) + sizeof(node.bounds_max)) != 0;
+    }
+
+    void index_topology() {
+        parents.assign(nodes.size(), 0);
+        leaves_of.clear();
+
+        for (uint32_t i = 0; i < nodes.size(); i++) {
+            const auto& node = nodes[i];
+
+            if (node.is_leaf()) {
+                for (uint32_t p = node.offset; p < node.offset + node.count; p++)
+                    leaves_of.emplace(primitives[p].get(), i);
+            } else {
+                parents[i + 1] = i;
+                parents[node.offset] = i;
+            }
+        }
+    }
+
+    uint32_t flatten(const bvh_node& node) {
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+        nodes[index].set_bounds(node.box);
+
+        if (node.left == node.right) {
+            add_leaf(index, node.left);
+            return index;
+        }
+
+        nodes[index].axis = static_cast<uint8_t>(node.split_axis);
+        flatten_child(node.left, node.box);
+        nodes[index].offset = flatten_child(node.right, node.box);
+
+        return index;
+    }
+
+    uint32_t flatten_child(
+        const std::shared_ptr<hittable>& child,
+        const aabb& parent_box
+    ) {
+        if (auto node = std::dynamic_pointer_cast<bvh_node>(child))
+            return flatten(*node);
+
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+
+        aabb child_box;
+        if (!child->bounding_box(time0, time1, child_box))
+            child_box = parent_box;
+
+        nodes[index].set_bounds(child_box);
+        add_leaf(index, child);
+
+        return index;
+    }
+
+    void add_leaf(uint32_t index, const std::shared_ptr<hittable>& leaf) {
+        nodes[index].offset = static_cast<uint32_t>(primitives.size());
+
+        if (auto list = std::dynamic_pointer_cast<hittable_list>(leaf)) {
+            for (const auto& object : list->objects)
+                primitives.push_back(object);
+        } else {
+            primitives.push_back(leaf);
+        }
+
+        nodes[index].count = static_cast<uint16_t>(
+            primitives.size() - nodes[index].offset);
+    }
+};
+
+#endif
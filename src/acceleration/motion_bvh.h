@@ -0,0 +1,259 @@
+#ifndef MOTION_BVH_H
+#define MOTION_BVH_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "rtweekend.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "bvh_builder.h"
+#include "linear_bvh.h"
+
+// A flattened BVH node with one box at shutter open (key 0) and one at
+// shutter close (key 1). A ray at shutter fraction s sees the box
+// linearly interpolated between the two.
+struct motion_bvh_node {
+    float bounds_min[2][3];
+    float bounds_max[2][3];
+    uint32_t offset;    // first primitive (leaf) or second child (interior)
+    uint16_t count;     // primitives in the leaf, 0 for interior nodes
+    uint8_t axis;       // split axis of an interior node
+    uint8_t flags;      // as in linear_bvh_node
+
+    bool is_leaf() const { return count > 0; }
+    bool children_swapped() const {
+        return flags & linear_bvh_node::swapped_children;
+    }
+
+    void set_bounds(int key, const aabb& box) {
+        for (int a = 0; a < 3; a++) {
+            const interval& ax = box.axis_interval(a);
+            bounds_min[key][a] = linear_bvh_node::float_down(ax.min);
+            bounds_max[key][a] = linear_bvh_node::float_up(ax.max);
+        }
+    }
+
+    aabb bounds(int key) const {
+        return aabb(interval(bounds_min[key][0], bounds_max[key][0]),
+                    interval(bounds_min[key][1], bounds_max[key][1]),
+                    interval(bounds_min[key][2], bounds_max[key][2]));
+    }
+};
+
+// Slab test against the node's box at the ray's time, which motion_bvh
+// has already mapped to a shutter fraction in [0, 1].
+inline bool node_hit(
+    const motion_bvh_node& node,
+    const ray& r,
+    interval ray_t,
+    double& t_enter
+) {
+    const point3& origin = r.origin();
+    const vec3& inv_dir = r.inv_direction();
+    const double s = r.time();
+
+    for (int axis = 0; axis < 3; axis++) {
+        double lo = (1 - s) * node.bounds_min[0][axis] + s * node.bounds_min[1][axis];
+        double hi = (1 - s) * node.bounds_max[0][axis] + s * node.bounds_max[1][axis];
+
+        const int neg = r.sign(axis);
+        auto t0 = ((neg ? hi : lo) - origin[axis]) * inv_dir[axis];
+        auto t1 = ((neg ? lo : hi) - origin[axis]) * inv_dir[axis];
+
+        ray_t.min = t0 > ray_t.min ? t0 : ray_t.min;
+        ray_t.max = t1 < ray_t.max ? t1 : ray_t.max;
+    }
+
+    t_enter = ray_t.min;
+    return ray_t.min < ray_t.max;
+}
+
+// BVH for motion-blurred scenes. Instead of one box swept over the
+// whole shutter, every node keeps its bounds at time0 and time1 and
+// traversal interpolates them at the ray's time, so a moving object
+// only costs node visits near where it is when the ray is cast.
+//
+// Interpolating the end boxes is conservative for primitives whose
+// bounds move linearly over the shutter, as moving_sphere's do, and
+// for any box merged from such bounds.
+class motion_bvh : public hittable {
+public:
+    motion_bvh() {}
+
+    motion_bvh(
+        const hittable_list& list,
+        double _time0,
+        double _time1,
+        const bvh_build_options& options = bvh_build_options()
+    ) : time0(_time0), time1(_time1) {
+        const size_t count = list.objects.size();
+        std::vector<aabb> open(count), close(count), mid(count);
+
+        for (size_t i = 0; i < count; i++) {
+            const auto& object = list.objects[i];
+
+            if (!object->bounding_box(time0, time0, open[i])
+             || !object->bounding_box(time1, time1, close[i]))
+                std::cerr << "No bounding box in motion_bvh constructor.\n";
+
+            // Topology is built for the box at mid-shutter, where an
+            // average ray finds the object.
+            mid[i] = aabb(
+                interval(0.5 * (open[i].x.min + close[i].x.min), 0.5 * (open[i].x.max + close[i].x.max)),
+                interval(0.5 * (open[i].y.min + close[i].y.min), 0.5 * (open[i].y.max + close[i].y.max)),
+                interval(0.5 * (open[i].z.min + close[i].z.min), 0.5 * (open[i].z.max + close[i].z.max)));
+        }
+
+        // Spatial splits clip only the mid-shutter boxes that choose the
+        // topology; leaf bounds below are refilled from each primitive's
+        // whole end boxes, so split references stay conservative.
+        std::vector<linear_bvh_node> topology;
+        std::vector<uint32_t> order;
+
+        if (options.spatial_splits) {
+            std::vector<bool> splittable(count);
+            for (size_t i = 0; i < count; i++)
+                splittable[i] = !list.objects[i]->is_stochastic();
+
+            sbvh_builder builder(mid, splittable, options);
+            topology = std::move(builder.nodes);
+            order = std::move(builder.indices);
+        } else {
+            bvh_builder builder(mid, options);
+            topology = std::move(builder.nodes);
+            order = std::move(builder.indices);
+        }
+
+        // Laid out by the mid-shutter boxes, as for linear_bvh::reorder.
+        if (options.layout != bvh_layout::depth_first) {
+            bvh_layout_builder laid_out(topology, options.layout, options.treelet_bytes);
+            std::vector<uint32_t> ordered;
+            ordered.reserve(order.size());
+
+            for (auto& node : laid_out.nodes) {
+                if (!node.is_leaf())
+                    continue;
+
+                uint32_t first = static_cast<uint32_t>(ordered.size());
+                for (uint32_t p = node.offset; p < node.offset + node.count; p++)
+                    ordered.push_back(order[p]);
+                node.offset = first;
+            }
+
+            topology = std::move(laid_out.nodes);
+            order = std::move(ordered);
+        }
+
+        nodes.resize(topology.size());
+        for (size_t i = 0; i < nodes.size(); i++) {
+            const linear_bvh_node& source = topology[i];
+            nodes[i].offset = source.offset;
+            nodes[i].count = source.count;
+            nodes[i].axis = source.axis;
+            nodes[i].flags = source.flags;
+        }
+
+        primitives.reserve(order.size());
+        for (auto i : order)
+            primitives.push_back(list.objects[i]);
+
+        // Children sit after their parent, so one reverse sweep fills
+        // both keys bottom-up.
+        for (size_t i = nodes.size(); i-- > 0;) {
+            motion_bvh_node& node = nodes[i];
+            aabb b0 = empty_box();
+            aabb b1 = empty_box();
+
+            if (node.is_leaf()) {
+                for (uint32_t p = node.offset; p < node.offset + node.count; p++) {
+                    b0 = surrounding_box(b0, open[order[p]]);
+                    b1 = surrounding_box(b1, close[order[p]]);
+                }
+            } else {
+                b0 = surrounding_box(nodes[i + 1].bounds(0), nodes[node.offset].bounds(0));
+                b1 = surrounding_box(nodes[i + 1].bounds(1), nodes[node.offset].bounds(1));
+            }
+
+            node.set_bounds(0, b0);
+            node.set_bounds(1, b1);
+        }
+
+        if (!nodes.empty())
+            box = surrounding_box(nodes[0].bounds(0), nodes[0].bounds(1));
+    }
+
+    virtual bool hit(
+        const ray& r,
+        const interval& ray_t,
+        hit_record& rec
+    ) const override {
+
+        return traverse_linear_bvh(nodes, shutter_ray(r), ray_t,
+            [&](uint32_t first, uint32_t count, interval& t) {
+                bool hit_leaf = false;
+
+                for (uint32_t i = first; i < first + count; i++) {
+                    if (primitives[i]->hit(r, t, rec)) {
+                        hit_leaf = true;
+                        t.max = rec.t;
+                    }
+                }
+
+                return hit_leaf;
+            });
+    }
+
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+
+        return traverse_linear_bvh<true>(nodes, shutter_ray(r), ray_t,
+            [&](uint32_t first, uint32_t count, interval& t) {
+                for (uint32_t i = first; i < first + count; i++) {
+                    if (primitives[i]->occluded(r, t))
+                        return true;
+                }
+
+                return false;
+            });
+    }
+
+    virtual bool bounding_box(
+        double time0,
+        double time1,
+        aabb& output_box
+    ) const override {
+        if (nodes.empty())
+            return false;
+
+        output_box = box;
+        return true;
+    }
+
+    size_t node_count() const { return nodes.size(); }
+
+    size_t memory_bytes() const {
+        return nodes.size() * sizeof(motion_bvh_node)
+             + primitives.size() * sizeof(std::shared_ptr<hittable>);
+    }
+
+public:
+    std::vector<motion_bvh_node> nodes;
+    std::vector<std::shared_ptr<hittable>> primitives;
+    aabb box;
+
+private:
+    double time0 = 0;
+    double time1 = 0;
+
+    // Copy of r whose time is its fraction of the shutter, as node_hit
+    // expects. Primitives are still tested against the original ray.
+    ray shutter_ray(const ray& r) const {
+        double s = (time1 > time0) ? (r.time() - time0) / (time1 - time0) : 0.0;
+        return ray(r.origin(), r.direction(), clamp(s, 0.0, 1.0));
+    }
+};
+
+#endif
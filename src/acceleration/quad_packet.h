@@ -0,0 +1,158 @@
+#ifndef QUAD_PACKET_H
+#define QUAD_PACKET_H
+
+#include <cmath>
+#include <cstdint>
+#include "rtweekend.h"
+#include "interval.h"
+#include "ray.h"
+#include "triangle_packet.h"
+
+// Same lane type and SIMD selection as triangle packets.
+constexpr int quad_packet_width = triangle_packet_width;
+
+// Up to Width quads of one BVH leaf in structure-of-arrays form: each
+// quad's corner, unit plane normal and offset, and the two basis
+// vectors that give its (u, v) coordinates.
+template <int Width>
+struct alignas(32) quad_packet {
+    double q_x[Width], q_y[Width], q_z[Width];
+    double n_x[Width], n_y[Width], n_z[Width];
+    double d[Width];
+    double a_x[Width], a_y[Width], a_z[Width];
+    double b_x[Width], b_y[Width], b_z[Width];
+    uint32_t quad[Width];   // index of the source quad
+    uint8_t valid;          // bit k set when lane k holds a quad
+};
+
+template <int Width>
+struct quad_packet_hits {
+    double t[Width];
+    double alpha[Width];
+    double beta[Width];
+};
+
+// Intersects r with every quad of the packet at once. Returns the mask
+// of lanes hit inside ray_t. Each lane does the arithmetic of
+// quad::hit, in the same order, so results do not depend on the path.
+template <int Width>
+inline int quad_packet_test(
+    const quad_packet<Width>& p,
+    const ray& r,
+    const interval& ray_t,
+    quad_packet_hits<Width>& out
+) {
+    const point3& o = r.origin();
+    const vec3& d = r.direction();
+    int mask = 0;
+
+#if defined(RT_TRIANGLE_PACKET_AVX)
+    const __m256d ox = _mm256_set1_pd(o.x()), oy = _mm256_set1_pd(o.y()), oz = _mm256_set1_pd(o.z());
+    const __m256d dx = _mm256_set1_pd(d.x()), dy = _mm256_set1_pd(d.y()), dz = _mm256_set1_pd(d.z());
+    const __m256d tmin = _mm256_set1_pd(ray_t.min), tmax = _mm256_set1_pd(ray_t.max);
+    const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0);
+    const __m256d eps = _mm256_set1_pd(1e-8);
+    const __m256d abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffll));
+
+    for (int c = 0; c < Width; c += 4) {
+        __m256d nx = _mm256_load_pd(p.n_x + c), ny = _mm256_load_pd(p.n_y + c), nz = _mm256_load_pd(p.n_z + c);
+
+        __m256d denom = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(nx, dx), _mm256_mul_pd(ny, dy)),
+                                      _mm256_mul_pd(nz, dz));
+        __m256d dist = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(nx, ox), _mm256_mul_pd(ny, oy)),
+                                     _mm256_mul_pd(nz, oz));
+        __m256d t = _mm256_div_pd(_mm256_sub_pd(_mm256_load_pd(p.d + c), dist), denom);
+
+        __m256d px = _mm256_sub_pd(_mm256_add_pd(ox, _mm256_mul_pd(t, dx)), _mm256_load_pd(p.q_x + c));
+        __m256d py = _mm256_sub_pd(_mm256_add_pd(oy, _mm256_mul_pd(t, dy)), _mm256_load_pd(p.q_y + c));
+        __m256d pz = _mm256_sub_pd(_mm256_add_pd(oz, _mm256_mul_pd(t, dz)), _mm256_load_pd(p.q_z + c));
+
+        __m256d alpha = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(px, _mm256_load_pd(p.a_x + c)),
+                                                    _mm256_mul_pd(py, _mm256_load_pd(p.a_y + c))),
+                                      _mm256_mul_pd(pz, _mm256_load_pd(p.a_z + c)));
+        __m256d beta = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(px, _mm256_load_pd(p.b_x + c)),
+                                                   _mm256_mul_pd(py, _mm256_load_pd(p.b_y + c))),
+                                     _mm256_mul_pd(pz, _mm256_load_pd(p.b_z + c)));
+
+        __m256d ok = _mm256_cmp_pd(_mm256_and_pd(denom, abs_mask), eps, _CMP_GE_OQ);
+        ok = _mm256_and_pd(ok, _mm256_cmp_pd(t, tmin, _CMP_GT_OQ));
+        ok = _mm256_and_pd(ok, _mm256_cmp_pd(t, tmax, _CMP_LT_OQ));
+        ok = _mm256_and_pd(ok, _mm256_cmp_pd(alpha, zero, _CMP_GE_OQ));
+        ok = _mm256_and_pd(ok, _mm256_cmp_pd(alpha, one, _CMP_LE_OQ));
+        ok = _mm256_and_pd(ok, _mm256_cmp_pd(beta, zero, _CMP_GE_OQ));
+        ok = _mm256_and_pd(ok, _mm256_cmp_pd(beta, one, _CMP_LE_OQ));
+
+        _mm256_storeu_pd(out.t + c, t);
+        _mm256_storeu_pd(out.alpha + c, alpha);
+        _mm256_storeu_pd(out.beta + c, beta);
+        mask |= _mm256_movemask_pd(ok) << c;
+    }
+
+    return mask & p.valid;
+#elif defined(RT_TRIANGLE_PACKET_SSE)
+    const __m128d ox = _mm_set1_pd(o.x()), oy = _mm_set1_pd(o.y()), oz = _mm_set1_pd(o.z());
+    const __m128d dx = _mm_set1_pd(d.x()), dy = _mm_set1_pd(d.y()), dz = _mm_set1_pd(d.z());
+    const __m128d tmin = _mm_set1_pd(ray_t.min), tmax = _mm_set1_pd(ray_t.max);
+    const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1.0);
+    const __m128d eps = _mm_set1_pd(1e-8);
+    const __m128d abs_mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffll));
+
+    for (int c = 0; c < Width; c += 2) {
+        __m128d nx = _mm_load_pd(p.n_x + c), ny = _mm_load_pd(p.n_y + c), nz = _mm_load_pd(p.n_z + c);
+
+        __m128d denom = _mm_add_pd(_mm_add_pd(_mm_mul_pd(nx, dx), _mm_mul_pd(ny, dy)),
+                                   _mm_mul_pd(nz, dz));
+        __m128d dist = _mm_add_pd(_mm_add_pd(_mm_mul_pd(nx, ox), _mm_mul_pd(ny, oy)),
+                                  _mm_mul_pd(nz, oz));
+        __m128d t = _mm_div_pd(_mm_sub_pd(_mm_load_pd(p.d + c), dist), denom);
+
+        __m128d px = _mm_sub_pd(_mm_add_pd(ox, _mm_mul_pd(t, dx)), _mm_load_pd(p.q_x + c));
+        __m128d py = _mm_sub_pd(_mm_add_pd(oy, _mm_mul_pd(t, dy)), _mm_load_pd(p.q_y + c));
+        __m128d pz = _mm_sub_pd(_mm_add_pd(oz, _mm_mul_pd(t, dz)), _mm_load_pd(p.q_z + c));
+
+        __m128d alpha = _mm_add_pd(_mm_add_pd(_mm_mul_pd(px, _mm_load_pd(p.a_x + c)),
+                                              _mm_mul_pd(py, _mm_load_pd(p.a_y + c))),
+                                   _mm_mul_pd(pz, _mm_load_pd(p.a_z + c)));
+        __m128d beta = _mm_add_pd(_mm_add_pd(_mm_mul_pd(px, _mm_load_pd(p.b_x + c)),
+                                             _mm_mul_pd(py, _mm_load_pd(p.b_y + c))),
+                                  _mm_mul_pd(pz, _mm_load_pd(p.b_z + c)));
+
+        __m128d ok = _mm_cmpge_pd(_mm_and_pd(denom, abs_mask), eps);
+        ok = _mm_and_pd(ok, _mm_cmpgt_pd(t, tmin));
+        ok = _mm_and_pd(ok, _mm_cmplt_pd(t, tmax));
+        ok = _mm_and_pd(ok, _mm_cmpge_pd(alpha, zero));
+        ok = _mm_and_pd(ok, _mm_cmple_pd(alpha, one));
+        ok = _mm_and_pd(ok, _mm_cmpge_pd(beta, zero));
+        ok = _mm_and_pd(ok, _mm_cmple_pd(beta, one));
+
+        _mm_storeu_pd(out.t + c, t);
+        _mm_storeu_pd(out.alpha + c, alpha);
+        _mm_storeu_pd(out.beta + c, beta);
+        mask |= _mm_movemask_pd(ok) << c;
+    }
+
+    return mask & p.valid;
+#else
+    for (int k = 0; k < Width; k++) {
+        vec3 n(p.n_x[k], p.n_y[k], p.n_z[k]);
+        double denom = dot(n, d);
+        double t = (p.d[k] - dot(n, o)) / denom;
+
+        vec3 planar = r.at(t) - point3(p.q_x[k], p.q_y[k], p.q_z[k]);
+        double alpha = dot(planar, vec3(p.a_x[k], p.a_y[k], p.a_z[k]));
+        double beta = dot(planar, vec3(p.b_x[k], p.b_y[k], p.b_z[k]));
+
+        out.t[k] = t;
+        out.alpha[k] = alpha;
+        out.beta[k] = beta;
+
+        if (fabs(denom) >= 1e-8 && ray_t.surrounds(t)
+         && alpha >= 0 && alpha <= 1 && beta >= 0 && beta <= 1)
+            mask |= 1 << k;
+    }
+
+    return mask & p.valid;
+#endif
+}
+
+#endif
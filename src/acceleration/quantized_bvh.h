@@ -0,0 +1,277 @@
+#ifndef QUANTIZED_BVH_H
+#define QUANTIZED_BVH_H
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <memory>
+#include <vector>
+#include "rtweekend.h"
+#include "hittable.h"
+#include "linear_bvh.h"
+
+// A linear_bvh node whose box is stored as Q-bit integer offsets inside
+// its parent's (decoded) box. With Q = uint8_t a node takes 16 bytes,
+// with uint16_t 20 bytes, against 32 for linear_bvh_node.
+template <typename Q>
+struct quantized_bvh_node {
+    uint32_t offset;    // first primitive (leaf) or second child (interior)
+    uint16_t count;     // primitives in the leaf, 0 for interior nodes
+    uint8_t axis;       // split axis of an interior node
+    uint8_t flags;      // as in linear_bvh_node
+    Q lo[3];
+    Q hi[3];
+
+    bool is_leaf() const { return count > 0; }
+    bool children_swapped() const {
+        return flags & linear_bvh_node::swapped_children;
+    }
+};
+
+// Compressed BVH with the same topology as the linear_bvh it is built
+// from. Child boxes are rounded outwards on encoding, so every decoded
+// box contains the exact one and no hits are lost; traversal pays a
+// multiply-add per box face to decode them.
+template <typename Q>
+class quantized_bvh : public hittable {
+public:
+    static_assert(std::is_unsigned<Q>::value, "quantized_bvh needs an unsigned type");
+
+    static constexpr double levels = std::numeric_limits<Q>::max();
+
+    quantized_bvh() {}
+
+    explicit quantized_bvh(const linear_bvh& source)
+        : primitives(source.primitives) {
+
+        if (source.nodes.empty())
+            return;
+
+        root_box = source.nodes[0].bounds();
+        nodes.resize(source.nodes.size());
+        encode(source.nodes, 0, root_box);
+    }
+
+    virtual bool hit(
+        const ray& r,
+        const interval& ray_t,
+        hit_record& rec
+    ) const override {
+
+        return traverse<false>(r, ray_t,
+            [&](uint32_t first, uint32_t count, interval& t) {
+                bool hit_leaf = false;
+
+                for (uint32_t i = first; i < first + count; i++) {
+                    if (primitives[i]->hit(r, t, rec)) {
+                        hit_leaf = true;
+                        t.max = rec.t;
+                    }
+                }
+
+                return hit_leaf;
+            });
+    }
+
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+
+        return traverse<true>(r, ray_t,
+            [&](uint32_t first, uint32_t count, interval& t) {
+                for (uint32_t i = first; i < first + count; i++) {
+                    if (primitives[i]->occluded(r, t))
+                        return true;
+                }
+
+                return false;
+            });
+    }
+
+    virtual bool bounding_box(
+        double time0,
+        double time1,
+        aabb& output_box
+    ) const override {
+        if (nodes.empty())
+            return false;
+
+        output_box = root_box;
+        return true;
+    }
+
+    size_t node_count() const { return nodes.size(); }
+
+    static constexpr size_t bytes_per_node() {
+        return sizeof(quantized_bvh_node<Q>);
+    }
+
+    size_t memory_bytes() const {
+        return nodes.size() * bytes_per_node()
+             + primitives.size() * sizeof(std::shared_ptr<hittable>);
+    }
+
+    // Box of `node` as traversal sees it, given its parent's decoded box.
+    static aabb decode(const quantized_bvh_node<Q>& node, const aabb& parent) {
+        return aabb(
+            decode_axis(parent.x, node.lo[0], node.hi[0]),
+            decode_axis(parent.y, node.lo[1], node.hi[1]),
+            decode_axis(parent.z, node.lo[2], node.hi[2]));
+    }
+
+public:
+    std::vector<quantized_bvh_node<Q>> nodes;
+    std::vector<std::shared_ptr<hittable>> primitives;
+    aabb root_box;
+
+private:
+    static double decode_value(const interval& parent, Q q) {
+        if (q == 0) return parent.min;
+        if (q == static_cast<Q>(levels)) return parent.max;
+        return parent.min + q * (parent.size() / levels);
+    }
+
+    static interval decode_axis(const interval& parent, Q lo, Q hi) {
+        return interval(decode_value(parent, lo), decode_value(parent, hi));
+    }
+
+    // Encodes node `index` against its parent's decoded box, then its
+    // children against the box decoded here, so rounding never
+    // compounds into a box that misses its contents.
+    void encode(
+        const std::vector<linear_bvh_node>& source,
+        uint32_t index,
+        const aabb& parent
+    ) {
+        const linear_bvh_node& s = source[index];
+        quantized_bvh_node<Q>& q = nodes[index];
+
+        q.offset = s.offset;
+        q.count = s.count;
+        q.axis = s.axis;
+        q.flags = s.flags;
+
+        for (int a = 0; a < 3; a++) {
+            const interval& p = parent.axis_interval(a);
+            double step = p.size() / levels;
+
+            if (step <= 0) {
+                q.lo[a] = 0;
+                q.hi[a] = static_cast<Q>(levels);
+                continue;
+            }
+
+            double lo = std::floor((s.bounds_min[a] - p.min) / step);
+            double hi = std::ceil((s.bounds_max[a] - p.min) / step);
+
+            Q qlo = static_cast<Q>(fmin(fmax(lo, 0.0), levels));
+            Q qhi = static_cast<Q>(fmin(fmax(hi, 0.0), levels));
+
+            while (qlo > 0 && decode_value(p, qlo) > s.bounds_min[a])
+                qlo--;
+            while (qhi < static_cast<Q>(levels) && decode_value(p, qhi) < s.bounds_max[a])
+                qhi++;
+
+            q.lo[a] = qlo;
+            q.hi[a] = qhi;
+        }
+
+        if (s.is_leaf())
+            return;
+
+        aabb decoded = decode(q, parent);
+        encode(source, index + 1, decoded);
+        encode(source, s.offset, decoded);
+    }
+
+    // Same walk as traverse_linear_bvh, carrying each node's decoded
+    // box on the stack so children can be decoded relative to it.
+    template <bool AnyHit, typename LeafHit>
+    bool traverse(
+        const ray& r,
+        interval ray_t,
+        LeafHit leaf_hit
+    ) const {
+
+        if (nodes.empty())
+            return false;
+
+        struct entry {
+            uint32_t index;
+            double t_enter;
+            aabb box;
+        };
+
+        entry stack[bvh_stack_size];
+        int stack_top = 0;
+        bool hit_anything = false;
+
+        double t_root;
+        aabb box = decode(nodes[0], root_box);
+        if (!box.hit(r, ray_t, t_root))
+            return false;
+
+        uint32_t current = 0;
+
+        while (true) {
+            const quantized_bvh_node<Q>& node = nodes[current];
+            RT_BVH_COUNT(nodes_visited, 1);
+
+            if (node.is_leaf()) {
+                RT_BVH_COUNT(primitives_tested, node.count);
+                if (leaf_hit(node.offset, node.count, ray_t)) {
+                    if (AnyHit)
+                        return true;
+                    hit_anything = true;
+                }
+            }
+            else {
+                uint32_t near = current + 1;
+                uint32_t far = node.offset;
+                if (r.sign(node.axis) != node.children_swapped())
+                    std::swap(near, far);
+
+                aabb near_box = decode(nodes[near], box);
+                aabb far_box = decode(nodes[far], box);
+
+                double t_near, t_far;
+                bool hit_near = near_box.hit(r, ray_t, t_near);
+                bool hit_far = far_box.hit(r, ray_t, t_far);
+
+                if (hit_near) {
+                    if (hit_far)
+                        stack[stack_top++] = {far, t_far, far_box};
+                    current = near;
+                    box = near_box;
+                    continue;
+                }
+
+                if (hit_far) {
+                    current = far;
+                    box = far_box;
+                    continue;
+                }
+            }
+
+            bool found = false;
+            while (stack_top > 0) {
+                const entry& e = stack[--stack_top];
+                if (e.t_enter < ray_t.max) {
+                    current = e.index;
+                    box = e.box;
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found)
+                break;
+        }
+
+        return hit_anything;
+    }
+};
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef SAH_H
+#define SAH_H
+
+#include <vector>
+#include <algorithm>
+#include "rtweekend.h"
+#include "aabb.h"
+
+// Deep SAH trees fall back to median splits past this depth, which
+// bounds the traversal stack at bvh_stack_size entries.
+constexpr int bvh_median_depth = 32;
+constexpr int bvh_stack_size = 64;
+
+enum class bvh_split_method {
+    random_median,
+    sah
+};
+
+// Order of flattened nodes in memory. Every layout keeps one child of
+// each interior node directly after it; they differ in which child
+// that is and in how subtrees are grouped.
+enum class bvh_layout {
+    depth_first,            // low side of the split first, as built
+    larger_child_first,     // child with the larger surface area first
+    treelet                 // larger child first, grouped into treelets
+};
+
+struct bvh_build_options {
+    bvh_split_method split = bvh_split_method::random_median;
+
+    // Binned SAH parameters. Costs are relative: only their ratio
+    // decides between splitting further and emitting a leaf.
+    int sah_bins = 16;
+    double traversal_cost = 1.0;
+    double intersection_cost = 1.0;
+    size_t max_leaf_size = 4;
+
+    // Build subtrees as OpenMP tasks; ranges smaller than the grain
+    // are built serially by whichever thread picked them up.
+    bool parallel = false;
+    size_t parallel_grain = 4096;
+
+    // Spatial splits (SBVH): primitives straddling a split plane may be
+    // referenced from both children. Splits are only tried where the
+    // object split's children overlap by more than alpha times the root
+    // area, and at most max_duplication * primitives extra references
+    // are created. Spatial builds ignore `parallel`.
+    bool spatial_splits = false;
+    double spatial_split_alpha = 1e-5;
+    double max_duplication = 0.3;
+
+    // Flattened BVHs are reordered after the build. Treelets gather
+    // the nodes a ray most likely visits together, by surface area,
+    // into blocks of about treelet_bytes; the default is one page.
+    bvh_layout layout = bvh_layout::depth_first;
+    size_t treelet_bytes = 4096;
+};
+
+struct sah_split {
+    int axis = -1;
+    int bin = 0;
+    double cost = infinity;
+    bool make_leaf = false;
+
+    double centroid_min = 0;
+    double bin_scale = 0;
+    int bins = 1;
+
+    // Objects whose centroid falls in a bin below `bin` go left.
+    bool goes_left(const aabb& box) const {
+        return bin_of(box.centroid()[axis]) < bin;
+    }
+
+    int bin_of(double c) const {
+        int b = static_cast<int>((c - centroid_min) * bin_scale);
+        return std::min(std::max(b, 0), bins - 1);
+    }
+};
+
+// Evaluates the binned surface area heuristic for `count` boxes
+// returned by box_at(i). The result either names the cheapest
+// centroid split or asks for a leaf when that is no more expensive.
+template <typename BoxAt>
+sah_split find_sah_split(
+    size_t count,
+    BoxAt box_at,
+    const bvh_build_options& options
+) {
+    sah_split best;
+
+    aabb bounds = empty_box();
+    aabb centroid_bounds = empty_box();
+
+    for (size_t i = 0; i < count; i++) {
+        const aabb& b = box_at(i);
+        bounds = surrounding_box(bounds, b);
+        point3 c = b.centroid();
+        centroid_bounds = surrounding_box(centroid_bounds, aabb(c, c));
+    }
+
+    double parent_area = bounds.surface_area();
+    double leaf_cost = options.intersection_cost * count;
+
+    const int bins = std::max(options.sah_bins, 2);
+    std::vector<aabb> bin_box(bins);
+    std::vector<size_t> bin_count(bins);
+    std::vector<double> right_area(bins);
+    std::vector<size_t> right_count(bins);
+
+    for (int axis = 0; axis < 3; axis++) {
+        const interval& extent = centroid_bounds.axis_interval(axis);
+        if (extent.size() <= 0)
+            continue;
+
+        sah_split candidate;
+        candidate.axis = axis;
+        candidate.bins = bins;
+        candidate.centroid_min = extent.min;
+        candidate.bin_scale = bins / extent.size();
+
+        std::fill(bin_box.begin(), bin_box.end(), empty_box());
+        std::fill(bin_count.begin(), bin_count.end(), 0);
+
+        for (size_t i = 0; i < count; i++) {
+            const aabb& b = box_at(i);
+            int k = candidate.bin_of(b.centroid()[axis]);
+            bin_box[k] = surrounding_box(bin_box[k], b);
+            bin_count[k]++;
+        }
+
+        aabb acc = empty_box();
+        size_t n = 0;
+        for (int k = bins - 1; k > 0; k--) {
+            acc = surrounding_box(acc, bin_box[k]);
+            n += bin_count[k];
+            right_area[k] = acc.surface_area();
+            right_count[k] = n;
+        }
+
+        acc = empty_box();
+        n = 0;
+        for (int k = 1; k < bins; k++) {
+            acc = surrounding_box(acc, bin_box[k-1]);
+            n += bin_count[k-1];
+
+            if (n == 0 || right_count[k] == 0)
+                continue;
+
+            double cost = options.traversal_cost
+                + options.intersection_cost
+                * (n * acc.surface_area()
+                   + right_count[k] * right_area[k])
+                / parent_area;
+
+            if (cost < best.cost) {
+                best = candidate;
+                best.bin = k;
+                best.cost = cost;
+            }
+        }
+    }
+
+    if (best.axis < 0) {
+        // All centroids coincide; no split can separate them.
+        best.cost = leaf_cost;
+        best.make_leaf = count <= options.max_leaf_size;
+        return best;
+    }
+
+    if (count <= options.max_leaf_size && leaf_cost <= best.cost) {
+        best.cost = leaf_cost;
+        best.make_leaf = true;
+    }
+
+    return best;
+}
+
+#endif
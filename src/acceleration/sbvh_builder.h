@@ -0,0 +1,353 @@
+#ifndef SBVH_BUILDER_H
+#define SBVH_BUILDER_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "rtweekend.h"
+#include "aabb.h"
+#include "sah.h"
+#include "bvh_builder.h"
+
+// Spatial-split BVH builder (SBVH). Besides binned object splits it
+// considers splitting space along a plane, placing primitives that
+// straddle it in both children with their boxes clipped to each side.
+// This keeps large thin primitives such as walls from inflating every
+// node around them. The output has the same form as bvh_builder, but
+// `indices` may list a primitive more than once.
+class sbvh_builder {
+public:
+    std::vector<linear_bvh_node> nodes;
+    std::vector<uint32_t> indices;
+
+    // splittable[i] is false for primitives that must stay in a single
+    // leaf; they are placed by centroid in spatial splits.
+    sbvh_builder(
+        const std::vector<aabb>& prim_boxes,
+        const std::vector<bool>& prim_splittable,
+        const bvh_build_options& build_options
+    ) : splittable(prim_splittable), options(build_options) {
+
+        options.max_leaf_size =
+            std::min<size_t>(std::max<size_t>(options.max_leaf_size, 1),
+                             UINT16_MAX);
+
+        if (prim_boxes.empty())
+            return;
+
+        std::vector<reference> refs(prim_boxes.size());
+        aabb bounds = empty_box();
+
+        for (size_t i = 0; i < prim_boxes.size(); i++) {
+            refs[i] = { static_cast<uint32_t>(i), prim_boxes[i] };
+            bounds = surrounding_box(bounds, prim_boxes[i]);
+        }
+
+        root_area = bounds.surface_area();
+        duplicate_budget =
+            static_cast<size_t>(prim_boxes.size() * options.max_duplication);
+
+        nodes.reserve(2 * prim_boxes.size());
+        indices.reserve(prim_boxes.size() + duplicate_budget);
+
+        build(refs, 0);
+    }
+
+    size_t duplicates() const { return duplicated; }
+
+private:
+    struct reference {
+        uint32_t prim;
+        aabb box;
+    };
+
+    struct spatial_split {
+        int axis = -1;
+        double position = 0;
+        double cost = infinity;
+    };
+
+    const std::vector<bool>& splittable;
+    bvh_build_options options;
+    double root_area = 0;
+    size_t duplicate_budget = 0;
+    size_t duplicated = 0;
+
+    uint32_t build(std::vector<reference>& refs, int depth) {
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+
+        aabb bounds = empty_box();
+        for (const auto& ref : refs)
+            bounds = surrounding_box(bounds, ref.box);
+
+        nodes[index].set_bounds(bounds);
+
+        size_t count = refs.size();
+
+        if (count == 1) {
+            make_leaf(index, refs);
+            return index;
+        }
+
+        std::vector<reference> left, right;
+        int axis = 0;
+
+        if (depth < bvh_median_depth) {
+            sah_split object = find_sah_split(
+                count,
+                [&](size_t i) -> const aabb& { return refs[i].box; },
+                options);
+
+            spatial_split spatial;
+            if (options.spatial_splits
+             && duplicated < duplicate_budget
+             && children_overlap(refs, object)) {
+                spatial = find_spatial_split(refs, bounds);
+            }
+
+            if (spatial.axis >= 0 && spatial.cost < object.cost) {
+                split_spatially(refs, spatial, left, right);
+                size_t added = left.size() + right.size() - count;
+
+                // A split that keeps every reference on both sides makes
+                // no progress, and one that would overrun the duplication
+                // budget is not allowed; use the object split instead.
+                if ((left.size() == count && right.size() == count)
+                 || duplicated + added > duplicate_budget) {
+                    left.clear();
+                    right.clear();
+                } else {
+                    axis = spatial.axis;
+                    duplicated += added;
+                }
+            }
+
+            if (left.empty() && right.empty()) {
+                if (object.make_leaf) {
+                    make_leaf(index, refs);
+                    return index;
+                }
+
+                if (object.axis >= 0) {
+                    axis = object.axis;
+                    for (auto& ref : refs)
+                        (object.goes_left(ref.box) ? left : right).push_back(ref);
+                }
+            }
+        }
+        else if (count <= options.max_leaf_size) {
+            make_leaf(index, refs);
+            return index;
+        }
+
+        if (left.empty() || right.empty()) {
+            left.clear();
+            right.clear();
+            axis = median_split(refs, left, right);
+        }
+
+        refs.clear();
+        refs.shrink_to_fit();
+
+        nodes[index].axis = static_cast<uint8_t>(axis);
+        build(left, depth + 1);
+        nodes[index].offset = build(right, depth + 1);
+
+        return index;
+    }
+
+    void make_leaf(uint32_t index, const std::vector<reference>& refs) {
+        nodes[index].offset = static_cast<uint32_t>(indices.size());
+        nodes[index].count = static_cast<uint16_t>(refs.size());
+
+        for (const auto& ref : refs)
+            indices.push_back(ref.prim);
+    }
+
+    // Spatial splits only pay off where the object split leaves the two
+    // children overlapping by a noticeable fraction of the root area.
+    bool children_overlap(
+        const std::vector<reference>& refs,
+        const sah_split& object
+    ) const {
+        if (object.axis < 0)
+            return true;
+
+        aabb left = empty_box();
+        aabb right = empty_box();
+
+        for (const auto& ref : refs) {
+            if (object.goes_left(ref.box))
+                left = surrounding_box(left, ref.box);
+            else
+                right = surrounding_box(right, ref.box);
+        }
+
+        double overlap = intersection(left, right).surface_area();
+        return overlap > options.spatial_split_alpha * root_area;
+    }
+
+    spatial_split find_spatial_split(
+        const std::vector<reference>& refs,
+        const aabb& bounds
+    ) const {
+        spatial_split best;
+
+        const int bins = std::max(options.sah_bins, 2);
+        std::vector<aabb> bin_box(bins);
+        std::vector<size_t> entries(bins), exits(bins);
+        std::vector<double> right_area(bins);
+        std::vector<size_t> right_count(bins);
+
+        double parent_area = bounds.surface_area();
+
+        for (int axis = 0; axis < 3; axis++) {
+            const interval& extent = bounds.axis_interval(axis);
+            if (extent.size() <= 0)
+                continue;
+
+            double width = extent.size() / bins;
+
+            std::fill(bin_box.begin(), bin_box.end(), empty_box());
+            std::fill(entries.begin(), entries.end(), 0);
+            std::fill(exits.begin(), exits.end(), 0);
+
+            auto bin_of = [&](double v) {
+                int b = static_cast<int>((v - extent.min) / width);
+                return std::min(std::max(b, 0), bins - 1);
+            };
+
+            for (const auto& ref : refs) {
+                const interval& r = ref.box.axis_interval(axis);
+
+                if (!splittable[ref.prim]) {
+                    int b = bin_of(0.5 * (r.min + r.max));
+                    bin_box[b] = surrounding_box(bin_box[b], ref.box);
+                    entries[b]++;
+                    exits[b]++;
+                    continue;
+                }
+
+                int first = bin_of(r.min);
+                int last = bin_of(r.max);
+
+                for (int b = first; b <= last; b++) {
+                    interval slab(extent.min + b * width,
+                                  extent.min + (b + 1) * width);
+                    bin_box[b] = surrounding_box(
+                        bin_box[b], clip(ref.box, axis, slab));
+                }
+
+                entries[first]++;
+                exits[last]++;
+            }
+
+            aabb acc = empty_box();
+            size_t n = 0;
+            for (int k = bins - 1; k > 0; k--) {
+                acc = surrounding_box(acc, bin_box[k]);
+                n += exits[k];
+                right_area[k] = acc.surface_area();
+                right_count[k] = n;
+            }
+
+            acc = empty_box();
+            n = 0;
+            for (int k = 1; k < bins; k++) {
+                acc = surrounding_box(acc, bin_box[k-1]);
+                n += entries[k-1];
+
+                if (n == 0 || right_count[k] == 0)
+                    continue;
+
+                double cost = options.traversal_cost
+                    + options.intersection_cost
+                    * (n * acc.surface_area()
+                       + right_count[k] * right_area[k])
+                    / parent_area;
+
+                if (cost < best.cost) {
+                    best.axis = axis;
+                    best.position = extent.min + k * width;
+                    best.cost = cost;
+                }
+            }
+        }
+
+        return best;
+    }
+
+    void split_spatially(
+        const std::vector<reference>& refs,
+        const spatial_split& split,
+        std::vector<reference>& left,
+        std::vector<reference>& right
+    ) {
+        const int axis = split.axis;
+        const double p = split.position;
+
+        for (const auto& ref : refs) {
+            const interval& r = ref.box.axis_interval(axis);
+
+            if (!splittable[ref.prim]) {
+                (0.5 * (r.min + r.max) < p ? left : right).push_back(ref);
+            }
+            else if (r.max <= p) {
+                left.push_back(ref);
+            }
+            else if (r.min >= p) {
+                right.push_back(ref);
+            }
+            else {
+                left.push_back({ ref.prim, clip(ref.box, axis, interval(r.min, p)) });
+                right.push_back({ ref.prim, clip(ref.box, axis, interval(p, r.max)) });
+            }
+        }
+    }
+
+    int median_split(
+        std::vector<reference>& refs,
+        std::vector<reference>& left,
+        std::vector<reference>& right
+    ) const {
+        aabb centroid_bounds = empty_box();
+        for (const auto& ref : refs) {
+            point3 c = ref.box.centroid();
+            centroid_bounds = surrounding_box(centroid_bounds, aabb(c, c));
+        }
+
+        int axis = 0;
+        for (int a = 1; a < 3; a++) {
+            if (centroid_bounds.axis_interval(a).size()
+              > centroid_bounds.axis_interval(axis).size())
+                axis = a;
+        }
+
+        auto mid = refs.begin() + refs.size() / 2;
+        std::nth_element(refs.begin(), mid, refs.end(),
+            [&](const reference& a, const reference& b) {
+                return a.box.centroid()[axis] < b.box.centroid()[axis];
+            });
+
+        left.assign(refs.begin(), mid);
+        right.assign(mid, refs.end());
+
+        return axis;
+    }
+
+    static aabb clip(aabb box, int axis, const interval& slab) {
+        interval& ax = axis == 0 ? box.x : axis == 1 ? box.y : box.z;
+        ax.min = fmax(ax.min, slab.min);
+        ax.max = fmin(ax.max, slab.max);
+        return box;
+    }
+
+    static aabb intersection(const aabb& a, const aabb& b) {
+        return aabb(interval(fmax(a.x.min, b.x.min), fmin(a.x.max, b.x.max)),
+                    interval(fmax(a.y.min, b.y.min), fmin(a.y.max, b.y.max)),
+                    interval(fmax(a.z.min, b.z.min), fmin(a.z.max, b.z.max)));
+    }
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef SPHERE_PACKET_H
+#define SPHERE_PACKET_H
+
+#include <cmath>
+#include <cstdint>
+#include "rtweekend.h"
+#include "interval.h"
+#include "ray.h"
+#include "triangle_packet.h"
+
+// Same lane type and SIMD selection as triangle packets.
+constexpr int sphere_packet_width = triangle_packet_width;
+
+// Up to Width spheres of one BVH leaf in structure-of-arrays form.
+template <int Width>
+struct alignas(32) sphere_packet {
+    double c_x[Width], c_y[Width], c_z[Width];
+    double radius[Width];
+    uint32_t sphere[Width];   // index of the source sphere
+    uint8_t valid;            // bit k set when lane k holds a sphere
+};
+
+// Per-lane results of one packet test. The root is left scaled by the
+// ray's |d|^2, which keeps divisions out of the kernel; distance()
+// divides it out for the lane that is kept.
+template <int Width>
+struct sphere_packet_hits {
+    double root[Width];
+    double a;
+
+    double distance(int k) const { return root[k] / a; }
+};
+
+// Intersects r with every sphere of the packet at once: the nearer root
+// if it lies inside ray_t, else the farther one, as sphere::hit does.
+// Returns the mask of lanes hit.
+template <int Width>
+inline int sphere_packet_test(
+    const sphere_packet<Width>& p,
+    const ray& r,
+    const interval& ray_t,
+    sphere_packet_hits<Width>& out
+) {
+    const point3& o = r.origin();
+    const vec3& d = r.direction();
+    const double a = d.length_squared();
+    int mask = 0;
+
+    out.a = a;
+
+#if defined(RT_TRIANGLE_PACKET_AVX)
+    const __m256d ox = _mm256_set1_pd(o.x()), oy = _mm256_set1_pd(o.y()), oz = _mm256_set1_pd(o.z());
+    const __m256d dx = _mm256_set1_pd(d.x()), dy = _mm256_set1_pd(d.y()), dz = _mm256_set1_pd(d.z());
+    const __m256d va = _mm256_set1_pd(a);
+    const __m256d lo = _mm256_set1_pd(ray_t.min * a), hi = _mm256_set1_pd(ray_t.max * a);
+    const __m256d zero = _mm256_setzero_pd();
+
+    for (int c = 0; c < Width; c += 4) {
+        __m256d ocx = _mm256_sub_pd(ox, _mm256_load_pd(p.c_x + c));
+        __m256d ocy = _mm256_sub_pd(oy, _mm256_load_pd(p.c_y + c));
+        __m256d ocz = _mm256_sub_pd(oz, _mm256_load_pd(p.c_z + c));
+        __m256d radius = _mm256_load_pd(p.radius + c);
+
+        __m256d half_b = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ocx, dx), _mm256_mul_pd(ocy, dy)),
+                                       _mm256_mul_pd(ocz, dz));
+        __m256d oc2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ocx, ocx), _mm256_mul_pd(ocy, ocy)),
+                                    _mm256_mul_pd(ocz, ocz));
+        __m256d cc = _mm256_sub_pd(oc2, _mm256_mul_pd(radius, radius));
+
+        __m256d disc = _mm256_sub_pd(_mm256_mul_pd(half_b, half_b), _mm256_mul_pd(va, cc));
+        __m256d sqrtd = _mm256_sqrt_pd(_mm256_max_pd(disc, zero));
+
+        __m256d near = _mm256_sub_pd(_mm256_sub_pd(zero, half_b), sqrtd);
+        __m256d far = _mm256_add_pd(_mm256_sub_pd(zero, half_b), sqrtd);
+
+        __m256d near_ok = _mm256_and_pd(_mm256_cmp_pd(near, lo, _CMP_GT_OQ), _mm256_cmp_pd(near, hi, _CMP_LT_OQ));
+        __m256d far_ok = _mm256_and_pd(_mm256_cmp_pd(far, lo, _CMP_GT_OQ), _mm256_cmp_pd(far, hi, _CMP_LT_OQ));
+
+        __m256d ok = _mm256_and_pd(_mm256_cmp_pd(disc, zero, _CMP_GE_OQ), _mm256_or_pd(near_ok, far_ok));
+
+        _mm256_storeu_pd(out.root + c, _mm256_blendv_pd(far, near, near_ok));
+        mask |= _mm256_movemask_pd(ok) << c;
+    }
+
+    return mask & p.valid;
+#elif defined(RT_TRIANGLE_PACKET_SSE)
+    const __m128d ox = _mm_set1_pd(o.x()), oy = _mm_set1_pd(o.y()), oz = _mm_set1_pd(o.z());
+    const __m128d dx = _mm_set1_pd(d.x()), dy = _mm_set1_pd(d.y()), dz = _mm_set1_pd(d.z());
+    const __m128d va = _mm_set1_pd(a);
+    const __m128d lo = _mm_set1_pd(ray_t.min * a), hi = _mm_set1_pd(ray_t.max * a);
+    const __m128d zero = _mm_setzero_pd();
+
+    for (int c = 0; c < Width; c += 2) {
+        __m128d ocx = _mm_sub_pd(ox, _mm_load_pd(p.c_x + c));
+        __m128d ocy = _mm_sub_pd(oy, _mm_load_pd(p.c_y + c));
+        __m128d ocz = _mm_sub_pd(oz, _mm_load_pd(p.c_z + c));
+        __m128d radius = _mm_load_pd(p.radius + c);
+
+        __m128d half_b = _mm_add_pd(_mm_add_pd(_mm_mul_pd(ocx, dx), _mm_mul_pd(ocy, dy)),
+                                    _mm_mul_pd(ocz, dz));
+        __m128d oc2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(ocx, ocx), _mm_mul_pd(ocy, ocy)),
+                                 _mm_mul_pd(ocz, ocz));
+        __m128d cc = _mm_sub_pd(oc2, _mm_mul_pd(radius, radius));
+
+        __m128d disc = _mm_sub_pd(_mm_mul_pd(half_b, half_b), _mm_mul_pd(va, cc));
+        __m128d sqrtd = _mm_sqrt_pd(_mm_max_pd(disc, zero));
+
+        __m128d near = _mm_sub_pd(_mm_sub_pd(zero, half_b), sqrtd);
+        __m128d far = _mm_add_pd(_mm_sub_pd(zero, half_b), sqrtd);
+
+        __m128d near_ok = _mm_and_pd(_mm_cmpgt_pd(near, lo), _mm_cmplt_pd(near, hi));
+        __m128d far_ok = _mm_and_pd(_mm_cmpgt_pd(far, lo), _mm_cmplt_pd(far, hi));
+
+        __m128d ok = _mm_and_pd(_mm_cmpge_pd(disc, zero), _mm_or_pd(near_ok, far_ok));
+
+        // SSE2 has no blend: pick near where near_ok, far elsewhere.
+        __m128d root = _mm_or_pd(_mm_and_pd(near_ok, near), _mm_andnot_pd(near_ok, far));
+
+        _mm_storeu_pd(out.root + c, root);
+        mask |= _mm_movemask_pd(ok) << c;
+    }
+
+    return mask & p.valid;
+#else
+    for (int k = 0; k < Width; k++) {
+        vec3 oc = o - point3(p.c_x[k], p.c_y[k], p.c_z[k]);
+
+        double half_b = dot(oc, d);
+        double c = oc.length_squared() - p.radius[k] * p.radius[k];
+        double disc = half_b * half_b - a * c;
+
+        if (disc < 0)
+            continue;
+
+        double sqrtd = std::sqrt(disc);
+        double root = -half_b - sqrtd;
+
+        if (!(root > ray_t.min * a && root < ray_t.max * a))
+            root = -half_b + sqrtd;
+
+        out.root[k] = root;
+
+        if (root > ray_t.min * a && root < ray_t.max * a)
+            mask |= 1 << k;
+    }
+
+    return mask & p.valid;
+#endif
+}
+
+#endif
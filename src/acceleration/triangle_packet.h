@@ -0,0 +1,223 @@
+#ifndef TRIANGLE_PACKET_H
+#define TRIANGLE_PACKET_H
+
+#include <cmath>
+#include <cstdint>
+#include "rtweekend.h"
+#include "interval.h"
+#include "ray.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define RT_TRIANGLE_PACKET_SSE 1
+#endif
+
+#if defined(__AVX__)
+#define RT_TRIANGLE_PACKET_AVX 1
+#endif
+
+// Triangles per packet. Lanes are doubles, so a packet is one AVX or
+// two SSE2 registers wide per component.
+constexpr int triangle_packet_width = 4;
+
+// Up to Width triangles of one BVH leaf in structure-of-arrays form:
+// the first vertex and both edge vectors, ready for Möller-Trumbore.
+template <int Width>
+struct alignas(32) triangle_packet {
+    double v0_x[Width], v0_y[Width], v0_z[Width];
+    double e1_x[Width], e1_y[Width], e1_z[Width];
+    double e2_x[Width], e2_y[Width], e2_z[Width];
+    uint32_t triangle[Width];   // index of the source triangle
+    uint8_t valid;              // bit k set when lane k holds a triangle
+};
+
+// Per-lane results of one packet test. To keep divisions out of the
+// kernel, t, u and v are left scaled by det; hit() divides them out
+// for the lanes that are kept.
+template <int Width>
+struct triangle_packet_hits {
+    double t[Width];
+    double u[Width];
+    double v[Width];
+    double det[Width];
+
+    double distance(int k) const { return t[k] / det[k]; }
+    double b1(int k) const { return u[k] / det[k]; }
+    double b2(int k) const { return v[k] / det[k]; }
+};
+
+// Rays closer to parallel than this are rejected: |det| is compared
+// with |d| |e1| |e2|, which bounds it and scales with it, so the test
+// does not depend on the mesh's units.
+constexpr double triangle_relative_det_epsilon = 1e-12;
+
+// Intersects r with every triangle of the packet at once (Möller-
+// Trumbore, with the comparisons multiplied through by |det|). Returns
+// the mask of lanes hit inside ray_t.
+template <int Width>
+inline int triangle_packet_test(
+    const triangle_packet<Width>& p,
+    const ray& r,
+    const interval& ray_t,
+    triangle_packet_hits<Width>& out
+) {
+    const point3& o = r.origin();
+    const vec3& d = r.direction();
+    int mask = 0;
+
+    // det^2 >= eps^2 |d|^2 |e1|^2 |e2|^2, with the ray's part hoisted.
+    const double det_scale = triangle_relative_det_epsilon * triangle_relative_det_epsilon
+                           * d.length_squared();
+
+#if defined(RT_TRIANGLE_PACKET_AVX)
+    const __m256d ox = _mm256_set1_pd(o.x()), oy = _mm256_set1_pd(o.y()), oz = _mm256_set1_pd(o.z());
+    const __m256d dx = _mm256_set1_pd(d.x()), dy = _mm256_set1_pd(d.y()), dz = _mm256_set1_pd(d.z());
+    const __m256d tmin = _mm256_set1_pd(ray_t.min), tmax = _mm256_set1_pd(ray_t.max);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d scale = _mm256_set1_pd(det_scale);
+    const __m256d abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffll));
+
+    for (int c = 0; c < Width; c += 4) {
+        __m256d e1x = _mm256_load_pd(p.e1_x + c), e1y = _mm256_load_pd(p.e1_y + c), e1z = _mm256_load_pd(p.e1_z + c);
+        __m256d e2x = _mm256_load_pd(p.e2_x + c), e2y = _mm256_load_pd(p.e2_y + c), e2z = _mm256_load_pd(p.e2_z + c);
+
+        __m256d px = _mm256_sub_pd(_mm256_mul_pd(dy, e2z), _mm256_mul_pd(dz, e2y));
+        __m256d py = _mm256_sub_pd(_mm256_mul_pd(dz, e2x), _mm256_mul_pd(dx, e2z));
+        __m256d pz = _mm256_sub_pd(_mm256_mul_pd(dx, e2y), _mm256_mul_pd(dy, e2x));
+
+        __m256d det = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(e1x, px), _mm256_mul_pd(e1y, py)),
+                                    _mm256_mul_pd(e1z, pz));
+        __m256d abs_det = _mm256_and_pd(det, abs_mask);
+        __m256d sign = _mm256_andnot_pd(abs_mask, det);
+
+        __m256d tx = _mm256_sub_pd(ox, _mm256_load_pd(p.v0_x + c));
+        __m256d ty = _mm256_sub_pd(oy, _mm256_load_pd(p.v0_y + c));
+        __m256d tz = _mm256_sub_pd(oz, _mm256_load_pd(p.v0_z + c));
+
+        __m256d u = _mm256_xor_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(tx, px), _mm256_mul_pd(ty, py)),
+                                                _mm256_mul_pd(tz, pz)), sign);
+
+        __m256d qx = _mm256_sub_pd(_mm256_mul_pd(ty, e1z), _mm256_mul_pd(tz, e1y));
+        __m256d qy = _mm256_sub_pd(_mm256_mul_pd(tz, e1x), _mm256_mul_pd(tx, e1z));
+        __m256d qz = _mm256_sub_pd(_mm256_mul_pd(tx, e1y), _mm256_mul_pd(ty, e1x));
+
+        __m256d v = _mm256_xor_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, qx), _mm256_mul_pd(dy, qy)),
+                                                _mm256_mul_pd(dz, qz)), sign);
+        __m256d t = _mm256_xor_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(e2x, qx), _mm256_mul_pd(e2y, qy)),
+                                                _mm256_mul_pd(e2z, qz)), sign);
+
+        __m256d e1_sq = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(e1x, e1x), _mm256_mul_pd(e1y, e1y)),
+                                      _mm256_mul_pd(e1z, e1z));
+        __m256d e2_sq = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(e2x, e2x), _mm256_mul_pd(e2y, e2y)),
+                                      _mm256_mul_pd(e2z, e2z));
+        __m256d min_det_sq = _mm256_mul_pd(scale, _mm256_mul_pd(e1_sq, e2_sq));
+
+        __m256d ok = _mm256_cmp_pd(_mm256_mul_pd(det, det), min_det_sq, _CMP_GE_OQ);
+        ok = _mm256_and_pd(ok, _mm256_cmp_pd(abs_det, zero, _CMP_GT_OQ));
+        ok = _mm256_and_pd(ok, _mm256_cmp_pd(u, zero, _CMP_GE_OQ));
+        ok = _mm256_and_pd(ok, _mm256_cmp_pd(v, zero, _CMP_GE_OQ));
+        ok = _mm256_and_pd(ok, _mm256_cmp_pd(_mm256_add_pd(u, v), abs_det, _CMP_LE_OQ));
+        ok = _mm256_and_pd(ok, _mm256_cmp_pd(t, _mm256_mul_pd(tmin, abs_det), _CMP_GT_OQ));
+        ok = _mm256_and_pd(ok, _mm256_cmp_pd(t, _mm256_mul_pd(tmax, abs_det), _CMP_LT_OQ));
+
+        _mm256_storeu_pd(out.t + c, t);
+        _mm256_storeu_pd(out.u + c, u);
+        _mm256_storeu_pd(out.v + c, v);
+        _mm256_storeu_pd(out.det + c, abs_det);
+        mask |= _mm256_movemask_pd(ok) << c;
+    }
+
+    return mask & p.valid;
+#elif defined(RT_TRIANGLE_PACKET_SSE)
+    const __m128d ox = _mm_set1_pd(o.x()), oy = _mm_set1_pd(o.y()), oz = _mm_set1_pd(o.z());
+    const __m128d dx = _mm_set1_pd(d.x()), dy = _mm_set1_pd(d.y()), dz = _mm_set1_pd(d.z());
+    const __m128d tmin = _mm_set1_pd(ray_t.min), tmax = _mm_set1_pd(ray_t.max);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d scale = _mm_set1_pd(det_scale);
+    const __m128d abs_mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffll));
+
+    for (int c = 0; c < Width; c += 2) {
+        __m128d e1x = _mm_load_pd(p.e1_x + c), e1y = _mm_load_pd(p.e1_y + c), e1z = _mm_load_pd(p.e1_z + c);
+        __m128d e2x = _mm_load_pd(p.e2_x + c), e2y = _mm_load_pd(p.e2_y + c), e2z = _mm_load_pd(p.e2_z + c);
+
+        __m128d px = _mm_sub_pd(_mm_mul_pd(dy, e2z), _mm_mul_pd(dz, e2y));
+        __m128d py = _mm_sub_pd(_mm_mul_pd(dz, e2x), _mm_mul_pd(dx, e2z));
+        __m128d pz = _mm_sub_pd(_mm_mul_pd(dx, e2y), _mm_mul_pd(dy, e2x));
+
+        __m128d det = _mm_add_pd(_mm_add_pd(_mm_mul_pd(e1x, px), _mm_mul_pd(e1y, py)),
+                                 _mm_mul_pd(e1z, pz));
+        __m128d abs_det = _mm_and_pd(det, abs_mask);
+        __m128d sign = _mm_andnot_pd(abs_mask, det);
+
+        __m128d tx = _mm_sub_pd(ox, _mm_load_pd(p.v0_x + c));
+        __m128d ty = _mm_sub_pd(oy, _mm_load_pd(p.v0_y + c));
+        __m128d tz = _mm_sub_pd(oz, _mm_load_pd(p.v0_z + c));
+
+        __m128d u = _mm_xor_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(tx, px), _mm_mul_pd(ty, py)),
+                                          _mm_mul_pd(tz, pz)), sign);
+
+        __m128d qx = _mm_sub_pd(_mm_mul_pd(ty, e1z), _mm_mul_pd(tz, e1y));
+        __m128d qy = _mm_sub_pd(_mm_mul_pd(tz, e1x), _mm_mul_pd(tx, e1z));
+        __m128d qz = _mm_sub_pd(_mm_mul_pd(tx, e1y), _mm_mul_pd(ty, e1x));
+
+        __m128d v = _mm_xor_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, qx), _mm_mul_pd(dy, qy)),
+                                          _mm_mul_pd(dz, qz)), sign);
+        __m128d t = _mm_xor_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(e2x, qx), _mm_mul_pd(e2y, qy)),
+                                          _mm_mul_pd(e2z, qz)), sign);
+
+        __m128d e1_sq = _mm_add_pd(_mm_add_pd(_mm_mul_pd(e1x, e1x), _mm_mul_pd(e1y, e1y)),
+                                   _mm_mul_pd(e1z, e1z));
+        __m128d e2_sq = _mm_add_pd(_mm_add_pd(_mm_mul_pd(e2x, e2x), _mm_mul_pd(e2y, e2y)),
+                                   _mm_mul_pd(e2z, e2z));
+        __m128d min_det_sq = _mm_mul_pd(scale, _mm_mul_pd(e1_sq, e2_sq));
+
+        __m128d ok = _mm_cmpge_pd(_mm_mul_pd(det, det), min_det_sq);
+        ok = _mm_and_pd(ok, _mm_cmpgt_pd(abs_det, zero));
+        ok = _mm_and_pd(ok, _mm_cmpge_pd(u, zero));
+        ok = _mm_and_pd(ok, _mm_cmpge_pd(v, zero));
+        ok = _mm_and_pd(ok, _mm_cmple_pd(_mm_add_pd(u, v), abs_det));
+        ok = _mm_and_pd(ok, _mm_cmpgt_pd(t, _mm_mul_pd(tmin, abs_det)));
+        ok = _mm_and_pd(ok, _mm_cmplt_pd(t, _mm_mul_pd(tmax, abs_det)));
+
+        _mm_storeu_pd(out.t + c, t);
+        _mm_storeu_pd(out.u + c, u);
+        _mm_storeu_pd(out.v + c, v);
+        _mm_storeu_pd(out.det + c, abs_det);
+        mask |= _mm_movemask_pd(ok) << c;
+    }
+
+    return mask & p.valid;
+#else
+    for (int k = 0; k < Width; k++) {
+        vec3 e1(p.e1_x[k], p.e1_y[k], p.e1_z[k]);
+        vec3 e2(p.e2_x[k], p.e2_y[k], p.e2_z[k]);
+
+        vec3 pvec = cross(d, e2);
+        double det = dot(e1, pvec);
+        double sign = det < 0 ? -1.0 : 1.0;
+        double abs_det = fabs(det);
+
+        vec3 tvec = o - point3(p.v0_x[k], p.v0_y[k], p.v0_z[k]);
+        vec3 qvec = cross(tvec, e1);
+
+        double u = sign * dot(tvec, pvec);
+        double v = sign * dot(d, qvec);
+        double t = sign * dot(e2, qvec);
+
+        out.t[k] = t;
+        out.u[k] = u;
+        out.v[k] = v;
+        out.det[k] = abs_det;
+
+        double min_det_sq = det_scale * e1.length_squared() * e2.length_squared();
+
+        if (det * det >= min_det_sq && abs_det > 0 && u >= 0 && v >= 0 && u + v <= abs_det
+         && t > ray_t.min * abs_det && t < ray_t.max * abs_det)
+            mask |= 1 << k;
+    }
+
+    return mask & p.valid;
+#endif
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef TWO_LEVEL_H
+#define TWO_LEVEL_H
+
+#include <memory>
+#include "hittable_list.h"
+#include "linear_bvh.h"
+#include "transform_instance.h"
+
+// Two-level acceleration: geometry that is placed more than once is
+// built into a single bottom-level BVH in its own object space, and
+// each placement is a transform_instance referencing it. The scene BVH
+// is then built over the instances and acts as the top level.
+inline std::shared_ptr<hittable> make_blas(
+    const hittable_list& geometry,
+    const bvh_build_options& options = bvh_build_options()
+) {
+    if (geometry.objects.size() == 1)
+        return geometry.objects[0];
+
+    return std::make_shared<linear_bvh>(geometry, 0.0, 1.0, options);
+}
+
+#endif
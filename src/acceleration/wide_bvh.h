@@ -0,0 +1,371 @@
+#ifndef WIDE_BVH_H
+#define WIDE_BVH_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "rtweekend.h"
+#include "hittable.h"
+#include "linear_bvh.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define RT_WIDE_BVH_SSE 1
+#endif
+
+#if defined(__AVX__)
+#define RT_WIDE_BVH_AVX 1
+constexpr int wide_bvh_default_width = 8;
+#else
+constexpr int wide_bvh_default_width = 4;
+#endif
+
+// A BVH node with up to Width children whose boxes are stored as
+// structure-of-arrays, so one SIMD slab test covers every child.
+template <int Width>
+struct alignas(32) wide_bvh_node {
+    float min_x[Width], min_y[Width], min_z[Width];
+    float max_x[Width], max_y[Width], max_z[Width];
+    uint32_t child[Width];  // node index, or first primitive of a leaf
+    uint16_t count[Width];  // primitives in a leaf child, 0 for nodes
+    uint8_t valid;          // bit k set when slot k holds a child
+};
+
+// Ray data splatted once per traversal in the precision of the nodes.
+struct wide_ray {
+    float origin[3];
+    float inv_dir[3];
+};
+
+// Returns the mask of children whose boxes overlap [tmin, tmax] and
+// writes each child's entry distance to tnear.
+template <int Width>
+inline int wide_slab_test(
+    const wide_bvh_node<Width>& node,
+    const wide_ray& r,
+    float tmin,
+    float tmax,
+    float* tnear
+) {
+#if defined(RT_WIDE_BVH_AVX)
+    if constexpr (Width == 8) {
+        __m256 ox = _mm256_set1_ps(r.origin[0]);
+        __m256 oy = _mm256_set1_ps(r.origin[1]);
+        __m256 oz = _mm256_set1_ps(r.origin[2]);
+        __m256 ix = _mm256_set1_ps(r.inv_dir[0]);
+        __m256 iy = _mm256_set1_ps(r.inv_dir[1]);
+        __m256 iz = _mm256_set1_ps(r.inv_dir[2]);
+
+        __m256 x0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.min_x), ox), ix);
+        __m256 x1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.max_x), ox), ix);
+        __m256 y0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.min_y), oy), iy);
+        __m256 y1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.max_y), oy), iy);
+        __m256 z0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.min_z), oz), iz);
+        __m256 z1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.max_z), oz), iz);
+
+        __m256 t_enter = _mm256_max_ps(
+            _mm256_max_ps(_mm256_min_ps(x0, x1), _mm256_min_ps(y0, y1)),
+            _mm256_max_ps(_mm256_min_ps(z0, z1), _mm256_set1_ps(tmin)));
+
+        __m256 t_exit = _mm256_min_ps(
+            _mm256_min_ps(_mm256_max_ps(x0, x1), _mm256_max_ps(y0, y1)),
+            _mm256_min_ps(_mm256_max_ps(z0, z1), _mm256_set1_ps(tmax)));
+
+        _mm256_storeu_ps(tnear, t_enter);
+        return _mm256_movemask_ps(
+            _mm256_cmp_ps(t_enter, t_exit, _CMP_LE_OQ)) & node.valid;
+    }
+#endif
+#if defined(RT_WIDE_BVH_SSE)
+    if constexpr (Width == 4) {
+        __m128 ox = _mm_set1_ps(r.origin[0]);
+        __m128 oy = _mm_set1_ps(r.origin[1]);
+        __m128 oz = _mm_set1_ps(r.origin[2]);
+        __m128 ix = _mm_set1_ps(r.inv_dir[0]);
+        __m128 iy = _mm_set1_ps(r.inv_dir[1]);
+        __m128 iz = _mm_set1_ps(r.inv_dir[2]);
+
+        __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_x), ox), ix);
+        __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_x), ox), ix);
+        __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_y), oy), iy);
+        __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_y), oy), iy);
+        __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_z), oz), iz);
+        __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_z), oz), iz);
+
+        __m128 t_enter = _mm_max_ps(
+            _mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+            _mm_max_ps(_mm_min_ps(z0, z1), _mm_set1_ps(tmin)));
+
+        __m128 t_exit = _mm_min_ps(
+            _mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+            _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(tmax)));
+
+        _mm_storeu_ps(tnear, t_enter);
+        return _mm_movemask_ps(_mm_cmple_ps(t_enter, t_exit)) & node.valid;
+    }
+#endif
+
+    int mask = 0;
+
+    for (int k = 0; k < Width; k++) {
+        float x0 = (node.min_x[k] - r.origin[0]) * r.inv_dir[0];
+        float x1 = (node.max_x[k] - r.origin[0]) * r.inv_dir[0];
+        float y0 = (node.min_y[k] - r.origin[1]) * r.inv_dir[1];
+        float y1 = (node.max_y[k] - r.origin[1]) * r.inv_dir[1];
+        float z0 = (node.min_z[k] - r.origin[2]) * r.inv_dir[2];
+        float z1 = (node.max_z[k] - r.origin[2]) * r.inv_dir[2];
+
+        float t_enter = std::max(std::max(std::min(x0, x1), std::min(y0, y1)),
+                                 std::max(std::min(z0, z1), tmin));
+        float t_exit  = std::min(std::min(std::max(x0, x1), std::max(y0, y1)),
+                                 std::min(std::max(z0, z1), tmax));
+
+        tnear[k] = t_enter;
+        if (t_enter <= t_exit)
+            mask |= 1 << k;
+    }
+
+    return mask & node.valid;
+}
+
+// BVH with Width-way nodes (4 for SSE, 8 for AVX) collapsed from a
+// binary linear_bvh. Children are visited nearest first.
+template <int Width>
+class wide_bvh : public hittable {
+public:
+    static_assert(Width == 4 || Width == 8, "wide_bvh supports 4 or 8 children");
+
+    wide_bvh() {}
+
+    explicit wide_bvh(const linear_bvh& binary)
+        : primitives(binary.primitives), box(binary.box) {
+
+        if (binary.nodes.empty())
+            return;
+
+        // Slab tests run in single precision on a single-precision
+        // origin; pad every box by a margin that covers that rounding.
+        double extent = 0;
+        for (int a = 0; a < 3; a++) {
+            const interval& ax = box.axis_interval(a);
+            extent = fmax(extent, fmax(fabs(ax.min), fabs(ax.max)));
+        }
+        pad = static_cast<float>(extent * 0x1p-18);
+
+        collapse(binary.nodes, 0);
+    }
+
+    virtual bool hit(
+        const ray& r,
+        const interval& ray_t,
+        hit_record& rec
+    ) const override {
+
+        return traverse<false>(r, ray_t,
+            [&](uint32_t first, uint32_t count, interval& t) {
+                bool hit_leaf = false;
+
+                for (uint32_t i = first; i < first + count; i++) {
+                    if (primitives[i]->hit(r, t, rec)) {
+                        hit_leaf = true;
+                        t.max = rec.t;
+                    }
+                }
+
+                return hit_leaf;
+            });
+    }
+
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+
+        return traverse<true>(r, ray_t,
+            [&](uint32_t first, uint32_t count, interval& t) {
+                for (uint32_t i = first; i < first + count; i++) {
+                    if (primitives[i]->occluded(r, t))
+                        return true;
+                }
+
+                return false;
+            });
+    }
+
+    virtual bool bounding_box(
+        double time0,
+        double time1,
+        aabb& output_box
+    ) const override {
+        if (nodes.empty())
+            return false;
+
+        output_box = box;
+        return true;
+    }
+
+    size_t node_count() const { return nodes.size(); }
+
+    size_t memory_bytes() const {
+        return nodes.size() * sizeof(wide_bvh_node<Width>)
+             + primitives.size() * sizeof(std::shared_ptr<hittable>);
+    }
+
+public:
+    std::vector<wide_bvh_node<Width>> nodes;
+    std::vector<std::shared_ptr<hittable>> primitives;
+    aabb box;
+
+private:
+    float pad = 0;
+
+    // Same contract as traverse_linear_bvh: leaf_hit shrinks t.max to
+    // its closest hit, and AnyHit returns at the first leaf hit.
+    template <bool AnyHit, typename LeafHit>
+    bool traverse(
+        const ray& r,
+        const interval& ray_t,
+        LeafHit leaf_hit
+    ) const {
+
+        if (nodes.empty())
+            return false;
+
+        wide_ray wr;
+        for (int a = 0; a < 3; a++) {
+            wr.origin[a] = static_cast<float>(r.origin()[a]);
+            wr.inv_dir[a] = static_cast<float>(r.inv_direction()[a]);
+        }
+
+        struct entry {
+            uint32_t child;
+            uint16_t count;
+            float tnear;
+        };
+
+        entry stack[bvh_stack_size * Width];
+        int stack_top = 0;
+        stack[stack_top++] = {0, 0, -INFINITY};
+
+        interval t = ray_t;
+        bool hit_anything = false;
+        float tnear[Width];
+
+        // Float bounds on the ray interval, widened by one part in 2^20.
+        const float tmin = linear_bvh_node::float_down(t.min);
+        float tmax = linear_bvh_node::float_up(t.max * (1.0 + 0x1p-20));
+
+        while (stack_top > 0) {
+            entry e = stack[--stack_top];
+
+            if (e.tnear > tmax)
+                continue;
+
+            if (e.count > 0) {
+                RT_BVH_COUNT(primitives_tested, e.count);
+                if (leaf_hit(e.child, e.count, t)) {
+                    if (AnyHit)
+                        return true;
+
+                    hit_anything = true;
+                    tmax = linear_bvh_node::float_up(t.max * (1.0 + 0x1p-20));
+                }
+                continue;
+            }
+
+            const auto& node = nodes[e.child];
+            RT_BVH_COUNT(nodes_visited, 1);
+            int mask = wide_slab_test(node, wr, tmin, tmax, tnear);
+
+            // Push far children first so the nearest is popped next.
+            int first = stack_top;
+            while (mask) {
+                int k = lowest_bit(mask);
+                mask &= mask - 1;
+
+                entry child = {node.child[k], node.count[k], tnear[k]};
+                int j = stack_top++;
+                while (j > first && stack[j-1].tnear < child.tnear) {
+                    stack[j] = stack[j-1];
+                    j--;
+                }
+                stack[j] = child;
+            }
+        }
+
+        return hit_anything;
+    }
+
+    static int lowest_bit(int mask) {
+        return __builtin_ctz(static_cast<unsigned>(mask));
+    }
+
+    // Emits a wide node for binary node `index`, pulling in grandchildren
+    // (largest surface area first) until all Width slots are used.
+    uint32_t collapse(
+        const std::vector<linear_bvh_node>& binary,
+        uint32_t index
+    ) {
+        std::vector<uint32_t> slots;
+
+        if (binary[index].is_leaf()) {
+            slots.push_back(index);
+        } else {
+            slots.push_back(index + 1);
+            slots.push_back(binary[index].offset);
+        }
+
+        while (slots.size() < Width) {
+            int widest = -1;
+            double widest_area = -1;
+
+            for (size_t k = 0; k < slots.size(); k++) {
+                const auto& n = binary[slots[k]];
+                double area = n.bounds().surface_area();
+                if (!n.is_leaf() && area > widest_area) {
+                    widest = static_cast<int>(k);
+                    widest_area = area;
+                }
+            }
+
+            if (widest < 0)
+                break;
+
+            uint32_t expand = slots[widest];
+            slots[widest] = expand + 1;
+            slots.push_back(binary[expand].offset);
+        }
+
+        uint32_t wide_index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+
+        for (int k = 0; k < Width; k++) {
+            auto& node = nodes[wide_index];
+            node.min_x[k] = node.min_y[k] = node.min_z[k] = INFINITY;
+            node.max_x[k] = node.max_y[k] = node.max_z[k] = -INFINITY;
+            node.child[k] = 0;
+            node.count[k] = 0;
+        }
+
+        for (size_t k = 0; k < slots.size(); k++) {
+            const auto& b = binary[slots[k]];
+
+            uint32_t child = b.is_leaf() ? b.offset : collapse(binary, slots[k]);
+
+            auto& node = nodes[wide_index];
+            node.min_x[k] = b.bounds_min[0] - pad;
+            node.min_y[k] = b.bounds_min[1] - pad;
+            node.min_z[k] = b.bounds_min[2] - pad;
+            node.max_x[k] = b.bounds_max[0] + pad;
+            node.max_y[k] = b.bounds_max[1] + pad;
+            node.max_z[k] = b.bounds_max[2] + pad;
+            node.child[k] = child;
+            node.count[k] = b.count;
+            node.valid |= static_cast<uint8_t>(1 << k);
+        }
+
+        return wide_index;
+    }
+};
+
+#endif
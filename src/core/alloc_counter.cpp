@@ -0,0 +1,49 @@
+#include "alloc_counter.h"
+
+#ifdef RT_ALLOC_STATS
+
+#include <cstdlib>
+#include <new>
+
+// Replacements for the global allocation functions. The array and
+// nothrow forms forward to these by default; the sized deletes are
+// replaced too so that each pairs with its unsized form.
+
+void* operator new(std::size_t size) {
+    heap_allocation_counter().fetch_add(1, std::memory_order_relaxed);
+
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    heap_allocation_counter().fetch_add(1, std::memory_order_relaxed);
+
+    std::size_t align = static_cast<std::size_t>(alignment);
+    std::size_t rounded = (size + align - 1) / align * align;
+
+    if (void* p = std::aligned_alloc(align, rounded ? rounded : align))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Count of heap allocations made through operator new, for checking
+// that the render loop allocates nothing. It is maintained only with
+// RT_ALLOC_STATS, which replaces the global operator new in
+// alloc_counter.cpp; otherwise it stays at zero.
+inline std::atomic<uint64_t>& heap_allocation_counter() {
+    static std::atomic<uint64_t> count{0};
+    return count;
+}
+
+inline uint64_t heap_allocations() {
+    return heap_allocation_counter().load(std::memory_order_relaxed);
+}
+
+#endif
@@ -17,6 +17,10 @@ public:
     bool surrounds(double x) const {
         return min < x && x < max;
     }
+
+    double size() const {
+        return max - min;
+    }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,181 @@
+#ifndef MAT3X4_H
+#define MAT3X4_H
+
+#include <cmath>
+#include "vec3.h"
+#include "aabb.h"
+#include "rtweekend.h"
+
+// Affine transform stored as the top three rows of a 4x4 matrix:
+// a 3x3 linear part in columns 0-2 and a translation in column 3.
+class mat3x4 {
+public:
+    double m[3][4];
+
+    mat3x4() : mat3x4(identity()) {}
+
+    mat3x4(double m00, double m01, double m02, double m03,
+           double m10, double m11, double m12, double m13,
+           double m20, double m21, double m22, double m23)
+        : m{{m00, m01, m02, m03},
+            {m10, m11, m12, m13},
+            {m20, m21, m22, m23}} {}
+
+    static mat3x4 identity() {
+        return mat3x4(1, 0, 0, 0,
+                      0, 1, 0, 0,
+                      0, 0, 1, 0);
+    }
+
+    static mat3x4 translation(const vec3& offset) {
+        return mat3x4(1, 0, 0, offset.x(),
+                      0, 1, 0, offset.y(),
+                      0, 0, 1, offset.z());
+    }
+
+    static mat3x4 scaling(const vec3& s) {
+        return mat3x4(s.x(), 0,     0,     0,
+                      0,     s.y(), 0,     0,
+                      0,     0,     s.z(), 0);
+    }
+
+    // Right-handed rotations: a positive angle turns counterclockwise
+    // when looking down the axis towards the origin, so rotation_y
+    // turns +x towards -z, as rotate_y always has.
+    static mat3x4 rotation_x(double degrees) {
+        auto radians = degrees_to_radians(degrees);
+        auto s = sin(radians);
+        auto c = cos(radians);
+
+        return mat3x4(1, 0,  0, 0,
+                      0, c, -s, 0,
+                      0, s,  c, 0);
+    }
+
+    static mat3x4 rotation_y(double degrees) {
+        auto radians = degrees_to_radians(degrees);
+        auto s = sin(radians);
+        auto c = cos(radians);
+
+        return mat3x4( c, 0, s, 0,
+                       0, 1, 0, 0,
+                      -s, 0, c, 0);
+    }
+
+    static mat3x4 rotation_z(double degrees) {
+        auto radians = degrees_to_radians(degrees);
+        auto s = sin(radians);
+        auto c = cos(radians);
+
+        return mat3x4(c, -s, 0, 0,
+                      s,  c, 0, 0,
+                      0,  0, 1, 0);
+    }
+
+    // Rotation by `degrees` about an arbitrary axis through the origin.
+    static mat3x4 rotation(const vec3& axis, double degrees) {
+        auto radians = degrees_to_radians(degrees);
+        auto s = sin(radians);
+        auto c = cos(radians);
+        auto k = 1 - c;
+
+        vec3 a = unit_vector(axis);
+        auto x = a.x(), y = a.y(), z = a.z();
+
+        return mat3x4(c + k*x*x,   k*x*y - s*z, k*x*z + s*y, 0,
+                      k*y*x + s*z, c + k*y*y,   k*y*z - s*x, 0,
+                      k*z*x - s*y, k*z*y + s*x, c + k*z*z,   0);
+    }
+
+    point3 transform_point(const point3& p) const {
+        return point3(
+            m[0][0]*p.x() + m[0][1]*p.y() + m[0][2]*p.z() + m[0][3],
+            m[1][0]*p.x() + m[1][1]*p.y() + m[1][2]*p.z() + m[1][3],
+            m[2][0]*p.x() + m[2][1]*p.y() + m[2][2]*p.z() + m[2][3]);
+    }
+
+    vec3 transform_vector(const vec3& v) const {
+        return vec3(
+            m[0][0]*v.x() + m[0][1]*v.y() + m[0][2]*v.z(),
+            m[1][0]*v.x() + m[1][1]*v.y() + m[1][2]*v.z(),
+            m[2][0]*v.x() + m[2][1]*v.y() + m[2][2]*v.z());
+    }
+
+    // Applies the transpose of the linear part. Called on the inverse
+    // matrix, this maps object-space normals to world space.
+    vec3 transform_normal_transposed(const vec3& n) const {
+        return vec3(
+            m[0][0]*n.x() + m[1][0]*n.y() + m[2][0]*n.z(),
+            m[0][1]*n.x() + m[1][1]*n.y() + m[2][1]*n.z(),
+            m[0][2]*n.x() + m[1][2]*n.y() + m[2][2]*n.z());
+    }
+
+    aabb transform_box(const aabb& box) const {
+        point3 lo( infinity,  infinity,  infinity);
+        point3 hi(-infinity, -infinity, -infinity);
+
+        for (int i = 0; i < 2; i++) {
+            for (int j = 0; j < 2; j++) {
+                for (int k = 0; k < 2; k++) {
+                    point3 corner = transform_point(point3(
+                        i ? box.x.max : box.x.min,
+                        j ? box.y.max : box.y.min,
+                        k ? box.z.max : box.z.min));
+
+                    for (int c = 0; c < 3; c++) {
+                        lo[c] = fmin(lo[c], corner[c]);
+                        hi[c] = fmax(hi[c], corner[c]);
+                    }
+                }
+            }
+        }
+
+        return aabb(lo, hi);
+    }
+
+    mat3x4 inverse() const {
+        // Inverse of the linear part by cofactors.
+        double c00 = m[1][1]*m[2][2] - m[1][2]*m[2][1];
+        double c01 = m[1][2]*m[2][0] - m[1][0]*m[2][2];
+        double c02 = m[1][0]*m[2][1] - m[1][1]*m[2][0];
+
+        double det = m[0][0]*c00 + m[0][1]*c01 + m[0][2]*c02;
+        double inv_det = 1.0 / det;
+
+        mat3x4 r;
+        r.m[0][0] = c00 * inv_det;
+        r.m[0][1] = (m[0][2]*m[2][1] - m[0][1]*m[2][2]) * inv_det;
+        r.m[0][2] = (m[0][1]*m[1][2] - m[0][2]*m[1][1]) * inv_det;
+        r.m[1][0] = c01 * inv_det;
+        r.m[1][1] = (m[0][0]*m[2][2] - m[0][2]*m[2][0]) * inv_det;
+        r.m[1][2] = (m[0][2]*m[1][0] - m[0][0]*m[1][2]) * inv_det;
+        r.m[2][0] = c02 * inv_det;
+        r.m[2][1] = (m[0][1]*m[2][0] - m[0][0]*m[2][1]) * inv_det;
+        r.m[2][2] = (m[0][0]*m[1][1] - m[0][1]*m[1][0]) * inv_det;
+
+        vec3 t = r.transform_vector(vec3(m[0][3], m[1][3], m[2][3]));
+        r.m[0][3] = -t.x();
+        r.m[1][3] = -t.y();
+        r.m[2][3] = -t.z();
+
+        return r;
+    }
+};
+
+// Composition: (a * b) applies b first, then a.
+inline mat3x4 operator*(const mat3x4& a, const mat3x4& b) {
+    mat3x4 r;
+
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            r.m[i][j] = a.m[i][0]*b.m[0][j]
+                      + a.m[i][1]*b.m[1][j]
+                      + a.m[i][2]*b.m[2][j]
+                      + (j == 3 ? a.m[i][3] : 0.0);
+        }
+    }
+
+    return r;
+}
+
+#endif
@@ -10,11 +10,21 @@ public:
     ray(const point3& origin,
         const vec3& direction,
         double time = 0.0)
-        : orig(origin), dir(direction), tm(time) {}
+        : orig(origin), dir(direction), tm(time) {
 
-    point3 origin() const  { return orig; }
-    vec3 direction() const { return dir; }
-    double time() const    { return tm; }
+        // Box tests multiply by these instead of dividing per slab.
+        for (int axis = 0; axis < 3; axis++) {
+            inv_dir[axis] = 1.0 / dir[axis];
+            dir_sign[axis] = inv_dir[axis] < 0;
+        }
+    }
+
+    const point3& origin() const  { return orig; }
+    const vec3& direction() const { return dir; }
+    double time() const           { return tm; }
+
+    const vec3& inv_direction() const { return inv_dir; }
+    int sign(int axis) const          { return dir_sign[axis]; }
 
     point3 at(double t) const {
         return orig + t*dir;
@@ -24,6 +34,8 @@ private:
     point3 orig;
     vec3 dir;
     double tm;
+    vec3 inv_dir;
+    int dir_sign[3];
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,11 +2,13 @@
 
 #include <memory>
 #include "hittable.h"
-#include "hittable_list.h"
-#include "xy_rect.h"
-#include "xz_rect.h"
-#include "yz_rect.h"
+#include "aabb.h"
+#include "rtweekend.h"
 
+// Axis-aligned box, intersected with one slab test. The face hit is the
+// slab the ray enters last (or, from inside, leaves first); normal and
+// texture coordinates follow from its axis exactly as the six rects the
+// box used to be built from would give them.
 class box : public hittable {
 public:
     box() {}
@@ -15,47 +17,48 @@ public:
         const point3& p0,
         const point3& p1,
         std::shared_ptr<material> ptr
-    ) {
-        box_min = p0;
-        box_max = p1;
-
-        sides.add(std::make_shared<xy_rect>(
-            p0.x(), p1.x(),
-            p0.y(), p1.y(),
-            p1.z(), ptr));
-
-        sides.add(std::make_shared<xy_rect>(
-            p0.x(), p1.x(),
-            p0.y(), p1.y(),
-            p0.z(), ptr));
-
-        sides.add(std::make_shared<xz_rect>(
-            p0.x(), p1.x(),
-            p0.z(), p1.z(),
-            p1.y(), ptr));
-
-        sides.add(std::make_shared<xz_rect>(
-            p0.x(), p1.x(),
-            p0.z(), p1.z(),
-            p0.y(), ptr));
-
-        sides.add(std::make_shared<yz_rect>(
-            p0.y(), p1.y(),
-            p0.z(), p1.z(),
-            p1.x(), ptr));
-
-        sides.add(std::make_shared<yz_rect>(
-            p0.y(), p1.y(),
-            p0.z(), p1.z(),
-            p0.x(), ptr));
-    }
+    ) : bounds(p0, p1), mp(ptr) {}
 
     virtual bool hit(
         const ray& r,
         const interval& ray_t,
         hit_record& rec
     ) const override {
-        return sides.hit(r, ray_t, rec);
+
+        double t;
+        int axis;
+        if (!intersect(r, ray_t, t, axis))
+            return false;
+
+        rec.t = t;
+        rec.p = r.at(t);
+
+        // The other two axes, in order, give u and v, as for the rects.
+        int u_axis = axis == 0 ? 1 : 0;
+        int v_axis = axis == 2 ? 1 : 2;
+        const interval& u_range = bounds.axis_interval(u_axis);
+        const interval& v_range = bounds.axis_interval(v_axis);
+
+        rec.u = (rec.p[u_axis] - u_range.min) / u_range.size();
+        rec.v = (rec.p[v_axis] - v_range.min) / v_range.size();
+
+        // Like the rects, every face has the positive axis as its
+        // outward normal.
+        vec3 outward_normal(0, 0, 0);
+        outward_normal[axis] = 1;
+        rec.set_face_normal(r, outward_normal);
+        rec.mat_ptr = mp.get();
+
+        return true;
+    }
+
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+        double t;
+        int axis;
+        return intersect(r, ray_t, t, axis);
     }
 
     virtual bool bounding_box(
@@ -63,12 +66,60 @@ public:
         double time1,
         aabb& output_box
     ) const override {
-        output_box = aabb(box_min, box_max);
+        output_box = bounds;
         return true;
     }
 
 private:
-    point3 box_min;
-    point3 box_max;
-    hittable_list sides;
-};
\ No newline at end of file
+    aabb bounds;
+    std::shared_ptr<material> mp;
+
+    // Nearest face crossing strictly inside ray_t: the entry face, or
+    // the exit face when the entry lies before ray_t.min.
+    bool intersect(
+        const ray& r,
+        const interval& ray_t,
+        double& t,
+        int& axis
+    ) const {
+        const point3& origin = r.origin();
+        const vec3& inv_dir = r.inv_direction();
+
+        double t_near = -infinity, t_far = infinity;
+        int near_axis = 0, far_axis = 0;
+
+        for (int a = 0; a < 3; a++) {
+            const interval& ax = bounds.axis_interval(a);
+            const int neg = r.sign(a);
+
+            double t0 = ((neg ? ax.max : ax.min) - origin[a]) * inv_dir[a];
+            double t1 = ((neg ? ax.min : ax.max) - origin[a]) * inv_dir[a];
+
+            if (t0 > t_near) {
+                t_near = t0;
+                near_axis = a;
+            }
+            if (t1 < t_far) {
+                t_far = t1;
+                far_axis = a;
+            }
+        }
+
+        if (t_near > t_far)
+            return false;
+
+        if (ray_t.surrounds(t_near)) {
+            t = t_near;
+            axis = near_axis;
+            return true;
+        }
+
+        if (ray_t.surrounds(t_far)) {
+            t = t_far;
+            axis = far_axis;
+            return true;
+        }
+
+        return false;
+    }
+};
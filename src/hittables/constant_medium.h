@@ -71,11 +71,15 @@ public:
 
         rec.normal = vec3(1, 0, 0); // arbitrary
         rec.front_face = true;
-        rec.mat_ptr = phase_function;
+        rec.mat_ptr = phase_function.get();
 
         return true;
     }
 
+    virtual bool is_stochastic() const override {
+        return true;
+    }
+
     virtual bool bounding_box(double time0,
                               double time1,
                               aabb& output_box) const override {
@@ -21,6 +21,17 @@ public:
         return true;
     }
 
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+        return ptr->occluded(r, ray_t);
+    }
+
+    virtual bool is_stochastic() const override {
+        return ptr->is_stochastic();
+    }
+
     virtual bool bounding_box(
         double time0,
         double time1,
@@ -14,7 +14,11 @@ struct hit_record {
     bool front_face;
     double u;
     double v;
-    std::shared_ptr<material> mat_ptr;
+
+    // Borrowed from the hittable that was hit, which owns its material
+    // and outlives the render, so filling in a hit does no reference
+    // counting.
+    const material* mat_ptr = nullptr;
 
     void set_face_normal(const ray& r, const vec3& outward_normal) {
         front_face = dot(r.direction(), outward_normal) < 0;
@@ -40,6 +44,24 @@ public:
         aabb& output_box
     ) const = 0;
 
+    // Any-hit query: whether anything blocks r within ray_t. Unlike
+    // hit() it may stop at the first intersection it finds and never
+    // fills a hit_record.
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const {
+        hit_record rec;
+        return hit(r, ray_t, rec);
+    }
+
+    // Whether hit() depends on more than the ray, as for participating
+    // media that sample a distance. Such objects must not be referenced
+    // from two BVH leaves, or one ray would sample them twice.
+    virtual bool is_stochastic() const {
+        return false;
+    }
+
     virtual double pdf_value(const point3&, const vec3&) const {
         return 0.0;
     }
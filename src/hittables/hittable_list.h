@@ -30,24 +30,38 @@ public:
         hit_record& rec
     ) const override {
 
-        hit_record temp_rec;
+        // Objects only write rec when they report a hit, and each one
+        // is searched for a closer hit than the last, so rec can be
+        // filled in place.
         bool hit_anything = false;
         auto closest_so_far = ray_t.max;
 
         for (const auto& object : objects) {
             if (object->hit(r,
                             interval(ray_t.min, closest_so_far),
-                            temp_rec)) {
+                            rec)) {
 
                 hit_anything = true;
-                closest_so_far = temp_rec.t;
-                rec = temp_rec;
+                closest_so_far = rec.t;
             }
         }
 
         return hit_anything;
     }
 
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+
+        for (const auto& object : objects) {
+            if (object->occluded(r, ray_t))
+                return true;
+        }
+
+        return false;
+    }
+
     virtual bool bounding_box(
         double time0,
         double time1,
@@ -75,6 +89,15 @@ public:
         return true;
     }
 
+    virtual bool is_stochastic() const override {
+        for (const auto& object : objects) {
+            if (object->is_stochastic())
+                return true;
+        }
+
+        return false;
+    }
+
     virtual double pdf_value(
         const point3& origin,
         const vec3& direction
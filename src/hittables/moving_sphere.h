@@ -37,25 +37,10 @@ public:
         hit_record& rec
     ) const override {
 
-        vec3 oc = r.origin() - center(r.time());
-        auto a = r.direction().length_squared();
-        auto half_b = dot(oc, r.direction());
-        auto c = oc.length_squared() - radius * radius;
-
-        auto discriminant = half_b * half_b - a * c;
-        if (discriminant < 0)
+        double root;
+        if (!nearest_root(r, ray_t, root))
             return false;
 
-        auto sqrtd = sqrt(discriminant);
-
-        // Find nearest root in interval
-        auto root = (-half_b - sqrtd) / a;
-        if (!ray_t.surrounds(root)) {
-            root = (-half_b + sqrtd) / a;
-            if (!ray_t.surrounds(root))
-                return false;
-        }
-
         rec.t = root;
         rec.p = r.at(rec.t);
 
@@ -63,11 +48,19 @@ public:
             (rec.p - center(r.time())) / radius;
 
         rec.set_face_normal(r, outward_normal);
-        rec.mat_ptr = mat_ptr;
+        rec.mat_ptr = mat_ptr.get();
 
         return true;
     }
 
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+        double root;
+        return nearest_root(r, ray_t, root);
+    }
+
     virtual bool bounding_box(
         double _time0,
         double _time1,
@@ -94,6 +87,35 @@ public:
     double time0, time1;
     double radius;
     std::shared_ptr<material> mat_ptr;
+
+private:
+    bool nearest_root(
+        const ray& r,
+        const interval& ray_t,
+        double& root
+    ) const {
+
+        vec3 oc = r.origin() - center(r.time());
+        auto a = r.direction().length_squared();
+        auto half_b = dot(oc, r.direction());
+        auto c = oc.length_squared() - radius * radius;
+
+        auto discriminant = half_b * half_b - a * c;
+        if (discriminant < 0)
+            return false;
+
+        auto sqrtd = sqrt(discriminant);
+
+        // Find nearest root in interval
+        root = (-half_b - sqrtd) / a;
+        if (!ray_t.surrounds(root)) {
+            root = (-half_b + sqrtd) / a;
+            if (!ray_t.surrounds(root))
+                return false;
+        }
+
+        return true;
+    }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include "hittable.h"
+#include "aabb.h"
+#include "rtweekend.h"
+
+// Parallelogram spanned by edges u and v from corner Q, in any
+// orientation. The outward normal is cross(u, v); texture coordinates
+// run from 0 to 1 along u and v. The plane and the basis that maps a
+// plane point to (u, v) coordinates are precomputed, so a hit costs a
+// division and three dot products.
+class quad : public hittable {
+public:
+    quad() {}
+
+    quad(
+        const point3& _Q,
+        const vec3& _u,
+        const vec3& _v,
+        std::shared_ptr<material> mat
+    ) : quad(_Q, _u, _v, mat, false) {}
+
+    virtual bool hit(
+        const ray& r,
+        const interval& ray_t,
+        hit_record& rec
+    ) const override {
+
+        double t, alpha, beta;
+        if (!intersect(r, ray_t, t, alpha, beta))
+            return false;
+
+        set_hit_record(r, t, alpha, beta, rec);
+        return true;
+    }
+
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+        double t, alpha, beta;
+        return intersect(r, ray_t, t, alpha, beta);
+    }
+
+    virtual bool bounding_box(
+        double time0,
+        double time1,
+        aabb& output_box
+    ) const override {
+        output_box = bbox;
+        return true;
+    }
+
+    virtual double pdf_value(
+        const point3& origin,
+        const vec3& direction
+    ) const override {
+
+        hit_record rec;
+
+        if (!this->hit(
+                ray(origin, direction),
+                interval(0.001, infinity),
+                rec))
+            return 0;
+
+        double distance_squared =
+            rec.t * rec.t *
+            direction.length_squared();
+
+        double cosine =
+            fabs(dot(direction, rec.normal)
+                 / direction.length());
+
+        return distance_squared / (cosine * area);
+    }
+
+    // Uniform in area, so pdf_value is the matching density.
+    virtual vec3 random(
+        const point3& origin
+    ) const override {
+
+        auto random_point =
+            Q + random_double() * u + random_double() * v;
+
+        return random_point - origin;
+    }
+
+    // Fills rec for a hit found at distance t and plane coordinates
+    // (alpha, beta), by this quad or by a batch test over it.
+    void set_hit_record(
+        const ray& r,
+        double t,
+        double alpha,
+        double beta,
+        hit_record& rec
+    ) const {
+        rec.t = t;
+        rec.p = r.at(t);
+        rec.u = alpha;
+        rec.v = beta;
+        rec.set_face_normal(r, outward_normal);
+        rec.mat_ptr = mp.get();
+    }
+
+    const point3& corner() const { return Q; }
+    const vec3& plane_normal() const { return normal; }
+    double plane_offset() const { return D; }
+    const vec3& alpha_axis() const { return alpha_basis; }
+    const vec3& beta_axis() const { return beta_basis; }
+
+protected:
+    // flip_normal reverses the outward normal without changing the
+    // texture mapping, as the axis-aligned rects need for one axis.
+    quad(
+        const point3& _Q,
+        const vec3& _u,
+        const vec3& _v,
+        std::shared_ptr<material> mat,
+        bool flip_normal
+    ) : Q(_Q), u(_u), v(_v), mp(mat) {
+
+        vec3 n = cross(u, v);
+        normal = unit_vector(n);
+        outward_normal = flip_normal ? -normal : normal;
+        D = dot(normal, Q);
+        area = n.length();
+
+        // A plane point P has coordinates alpha = (P - Q) . alpha_basis
+        // and beta = (P - Q) . beta_basis.
+        vec3 w = n / dot(n, n);
+        alpha_basis = cross(v, w);
+        beta_basis = cross(w, u);
+
+        // Same padding as the rects, so flat boxes never have zero width.
+        point3 corners[3] = {Q + u, Q + v, Q + u + v};
+        point3 lo = Q, hi = Q;
+        for (const auto& c : corners) {
+            for (int a = 0; a < 3; a++) {
+                lo[a] = fmin(lo[a], c[a]);
+                hi[a] = fmax(hi[a], c[a]);
+            }
+        }
+
+        for (int a = 0; a < 3; a++) {
+            if (hi[a] - lo[a] < 0.0002) {
+                lo[a] -= 0.0001;
+                hi[a] += 0.0001;
+            }
+        }
+
+        bbox = aabb(lo, hi);
+    }
+
+private:
+    bool intersect(
+        const ray& r,
+        const interval& ray_t,
+        double& t,
+        double& alpha,
+        double& beta
+    ) const {
+        double denom = dot(normal, r.direction());
+
+        // Rays parallel to the plane miss.
+        if (fabs(denom) < 1e-8)
+            return false;
+
+        t = (D - dot(normal, r.origin())) / denom;
+        if (!ray_t.surrounds(t))
+            return false;
+
+        vec3 planar = r.at(t) - Q;
+        alpha = dot(planar, alpha_basis);
+        beta = dot(planar, beta_basis);
+
+        return alpha >= 0 && alpha <= 1 && beta >= 0 && beta <= 1;
+    }
+
+    point3 Q;
+    vec3 u, v;
+    vec3 normal;
+    vec3 outward_normal;
+    double D;
+    vec3 alpha_basis, beta_basis;
+    double area;
+    std::shared_ptr<material> mp;
+    aabb bbox;
+};
@@ -0,0 +1,180 @@
+#ifndef QUAD_SET_H
+#define QUAD_SET_H
+
+#include <memory>
+#include <vector>
+#include "rtweekend.h"
+#include "hittable.h"
+#include "bvh_builder.h"
+#include "linear_bvh.h"
+#include "quad.h"
+#include "quad_packet.h"
+
+// Many quads behind one hittable, for walls, floors and other flat
+// geometry that would otherwise fill the scene BVH with small leaves.
+// The set carries its own flattened BVH, and each leaf's quads are
+// stored as SoA packets tested a packet at a time; only the closest
+// hit is turned into a hit_record, by the quad it belongs to.
+class quad_set : public hittable {
+public:
+    quad_set() {}
+
+    quad_set(
+        const std::vector<std::shared_ptr<quad>>& _quads,
+        const bvh_build_options& options = default_build_options()
+    ) {
+        std::vector<aabb> boxes(_quads.size());
+        for (size_t i = 0; i < boxes.size(); i++)
+            _quads[i]->bounding_box(0, 1, boxes[i]);
+
+        bvh_builder builder(boxes, options);
+        nodes = std::move(builder.nodes);
+
+        // Quads are stored in leaf order, so a leaf's range indexes
+        // them directly.
+        quads.reserve(_quads.size());
+        for (auto i : builder.indices)
+            quads.push_back(_quads[i]);
+
+        build_packets();
+
+        if (!nodes.empty())
+            box = nodes[0].bounds();
+    }
+
+    static bvh_build_options default_build_options() {
+        bvh_build_options options;
+        options.split = bvh_split_method::sah;
+        options.max_leaf_size = quad_packet_width;
+        options.intersection_cost = 0.5;
+        return options;
+    }
+
+    virtual bool hit(
+        const ray& r,
+        const interval& ray_t,
+        hit_record& rec
+    ) const override {
+
+        uint32_t closest = 0;
+        double closest_t = 0, alpha = 0, beta = 0;
+
+        bool hit_anything = traverse_linear_bvh(nodes, r, ray_t,
+            [&](uint32_t first, uint32_t count, interval& t) {
+                bool hit_leaf = false;
+                quad_packet_hits<quad_packet_width> lanes;
+
+                for (uint32_t p = first; p < first + packets_in(count); p++) {
+                    int mask = quad_packet_test(packets[p], r, t, lanes);
+
+                    while (mask) {
+                        int k = __builtin_ctz(static_cast<unsigned>(mask));
+                        mask &= mask - 1;
+
+                        if (lanes.t[k] < t.max) {
+                            hit_leaf = true;
+                            t.max = lanes.t[k];
+                            closest = packets[p].quad[k];
+                            closest_t = lanes.t[k];
+                            alpha = lanes.alpha[k];
+                            beta = lanes.beta[k];
+                        }
+                    }
+                }
+
+                return hit_leaf;
+            });
+
+        if (!hit_anything)
+            return false;
+
+        quads[closest]->set_hit_record(r, closest_t, alpha, beta, rec);
+        return true;
+    }
+
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+
+        return traverse_linear_bvh<true>(nodes, r, ray_t,
+            [&](uint32_t first, uint32_t count, interval& t) {
+                quad_packet_hits<quad_packet_width> lanes;
+
+                for (uint32_t p = first; p < first + packets_in(count); p++) {
+                    if (quad_packet_test(packets[p], r, t, lanes))
+                        return true;
+                }
+
+                return false;
+            });
+    }
+
+    virtual bool bounding_box(
+        double time0,
+        double time1,
+        aabb& output_box
+    ) const override {
+        if (nodes.empty())
+            return false;
+
+        output_box = box;
+        return true;
+    }
+
+    size_t size() const { return quads.size(); }
+
+public:
+    std::vector<std::shared_ptr<quad>> quads;
+    std::vector<linear_bvh_node> nodes;
+    std::vector<quad_packet<quad_packet_width>> packets;
+    aabb box;
+
+private:
+    static uint32_t packets_in(uint32_t count) {
+        return (count + quad_packet_width - 1) / quad_packet_width;
+    }
+
+    // Packs each leaf's quads into packets and points the leaf at its
+    // first packet; leaf counts stay in quads.
+    void build_packets() {
+        packets.clear();
+
+        for (auto& node : nodes) {
+            if (!node.is_leaf())
+                continue;
+
+            uint32_t first = node.offset;
+            node.offset = static_cast<uint32_t>(packets.size());
+
+            for (uint32_t i = 0; i < node.count; i += quad_packet_width) {
+                quad_packet<quad_packet_width> p = {};
+
+                for (int k = 0; k < quad_packet_width && i + k < node.count; k++) {
+                    uint32_t index = first + i + k;
+                    const quad& q = *quads[index];
+
+                    p.q_x[k] = q.corner().x();
+                    p.q_y[k] = q.corner().y();
+                    p.q_z[k] = q.corner().z();
+                    p.n_x[k] = q.plane_normal().x();
+                    p.n_y[k] = q.plane_normal().y();
+                    p.n_z[k] = q.plane_normal().z();
+                    p.d[k] = q.plane_offset();
+                    p.a_x[k] = q.alpha_axis().x();
+                    p.a_y[k] = q.alpha_axis().y();
+                    p.a_z[k] = q.alpha_axis().z();
+                    p.b_x[k] = q.beta_axis().x();
+                    p.b_y[k] = q.beta_axis().y();
+                    p.b_z[k] = q.beta_axis().z();
+                    p.quad[k] = index;
+                    p.valid |= 1 << k;
+                }
+
+                packets.push_back(p);
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <utility>
+#include "rtweekend.h"
+#include "hittable.h"
+#include "sphere.h"
+#include "bvh_counters.h"
+
+// Sphere-tracing budget and tolerances, in world units.
+struct sdf_options {
+    int max_steps = 256;
+    double hit_epsilon = 1e-4;      // distance that counts as the surface
+    double normal_epsilon = 1e-4;   // finite-difference step for normals
+    double step_scale = 1.0;        // below 1 for fields that overestimate
+};
+
+// Procedural surface given by a signed distance function: negative
+// inside, positive outside, and never more than the true distance to
+// the surface (scaled by step_scale otherwise). The ray is clipped to
+// `bounds`, which must contain the whole surface, and marched in steps
+// of the distance to it. The normal is the field's gradient, taken by
+// finite differences at the final hit only; u and v map it onto the
+// unit sphere.
+//
+// A march that starts inside the surface band at the ray's origin first
+// steps out of it, so a ray leaving the surface does not hit it again
+// at once. Rays starting inside the shape find its far side, as media
+// boundaries need.
+template <typename Distance>
+class sdf_hittable : public hittable {
+public:
+    sdf_hittable(
+        Distance _distance,
+        const aabb& _bounds,
+        std::shared_ptr<material> m,
+        const sdf_options& _options = sdf_options()
+    ) : distance(std::move(_distance)),
+        bounds(_bounds),
+        mat_ptr(m),
+        options(_options) {}
+
+    virtual bool hit(
+        const ray& r,
+        const interval& ray_t,
+        hit_record& rec
+    ) const override {
+
+        double t;
+        if (!march(r, ray_t, t))
+            return false;
+
+        rec.t = t;
+        rec.p = r.at(t);
+
+        vec3 outward_normal = gradient(rec.p);
+        rec.set_face_normal(r, outward_normal);
+        rec.mat_ptr = mat_ptr.get();
+
+        get_sphere_uv(outward_normal, rec.u, rec.v);
+
+        return true;
+    }
+
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+        double t;
+        return march(r, ray_t, t);
+    }
+
+    virtual bool bounding_box(
+        double time0,
+        double time1,
+        aabb& output_box
+    ) const override {
+        output_box = bounds;
+        return true;
+    }
+
+private:
+    Distance distance;
+    aabb bounds;
+    std::shared_ptr<material> mat_ptr;
+    sdf_options options;
+
+    bool march(
+        const ray& r,
+        const interval& ray_t,
+        double& t_hit
+    ) const {
+
+        interval span = ray_t;
+        if (!bounds.clip(r, span))
+            return false;
+
+        RT_BVH_COUNT(sdf_marches, 1);
+
+        // Steps are taken in world units, t is in units of |d|.
+        const double inv_length = 1.0 / r.direction().length();
+        const double eps = options.hit_epsilon;
+
+        // A ray that entered through the bounds may meet the surface
+        // right there when the bounds are tight; only a ray whose own
+        // origin lies on the surface has to step off it first.
+        double t = span.min;
+        bool armed = span.min > ray_t.min;
+
+        for (int step = 1; step <= options.max_steps; step++) {
+            double d = std::fabs(distance(r.at(t)));
+
+            if (d < eps) {
+                if (armed && t > ray_t.min) {
+                    RT_BVH_COUNT(sdf_steps, step);
+                    t_hit = t;
+                    return true;
+                }
+            } else {
+                armed = true;
+            }
+
+            t += std::max(d * options.step_scale, eps) * inv_length;
+            if (t >= span.max) {
+                RT_BVH_COUNT(sdf_steps, step);
+                return false;
+            }
+        }
+
+        RT_BVH_COUNT(sdf_steps, options.max_steps);
+        RT_BVH_COUNT(sdf_exhausted, 1);
+        return false;
+    }
+
+    // Central differences on a tetrahedron: four evaluations instead of
+    // the six of per-axis differences.
+    vec3 gradient(const point3& p) const {
+        const double h = options.normal_epsilon;
+        const vec3 k0( 1, -1, -1), k1(-1, -1,  1);
+        const vec3 k2(-1,  1, -1), k3( 1,  1,  1);
+
+        vec3 g = k0 * distance(p + h * k0)
+               + k1 * distance(p + h * k1)
+               + k2 * distance(p + h * k2)
+               + k3 * distance(p + h * k3);
+
+        return unit_vector(g);
+    }
+};
+
+template <typename Distance>
+std::shared_ptr<sdf_hittable<Distance>> make_sdf_hittable(
+    Distance distance,
+    const aabb& bounds,
+    std::shared_ptr<material> m,
+    const sdf_options& options = sdf_options()
+) {
+    return std::make_shared<sdf_hittable<Distance>>(
+        std::move(distance), bounds, m, options);
+}
+
+// Building blocks for distance functions.
+inline double sdf_sphere(const point3& p, double radius) {
+    return p.length() - radius;
+}
+
+inline double sdf_box(const point3& p, const vec3& half_size) {
+    vec3 q(std::fabs(p.x()) - half_size.x(),
+           std::fabs(p.y()) - half_size.y(),
+           std::fabs(p.z()) - half_size.z());
+
+    vec3 outside(std::max(q.x(), 0.0), std::max(q.y(), 0.0), std::max(q.z(), 0.0));
+    return outside.length() + std::min(std::max(q.x(), std::max(q.y(), q.z())), 0.0);
+}
+
+inline double sdf_torus(const point3& p, double major, double minor) {
+    double ring = std::sqrt(p.x()*p.x() + p.z()*p.z()) - major;
+    return std::sqrt(ring*ring + p.y()*p.y()) - minor;
+}
+
+// Union that blends the shapes within distance k of each other.
+inline double sdf_smooth_union(double a, double b, double k) {
+    double h = std::clamp(0.5 + 0.5 * (b - a) / k, 0.0, 1.0);
+    return b + (a - b) * h - k * h * (1 - h);
+}
+
+// Power-8 Mandelbulb of radius about 1.2 around the origin, estimated
+// from the escape-time derivative. It underestimates only roughly, so
+// use a step_scale below 1.
+inline double sdf_mandelbulb(const point3& p, int iterations = 12) {
+    vec3 z = p;
+    double dr = 1.0;
+    double r = 0.0;
+
+    for (int i = 0; i < iterations; i++) {
+        r = z.length();
+        if (r > 2.0)
+            break;
+
+        double theta = std::acos(z.z() / r) * 8;
+        double phi = std::atan2(z.y(), z.x()) * 8;
+        dr = std::pow(r, 7) * 8 * dr + 1;
+
+        double zr = std::pow(r, 8);
+        z = zr * vec3(std::sin(theta) * std::cos(phi),
+                      std::sin(phi) * std::sin(theta),
+                      std::cos(theta)) + p;
+    }
+
+    return 0.5 * std::log(r) * r / dr;
+}
+
@@ -32,37 +32,30 @@ public:
         hit_record& rec
     ) const override {
 
-        vec3 oc = r.origin() - center;
-
-        auto a = r.direction().length_squared();
-        auto half_b = dot(oc, r.direction());
-        auto c = oc.length_squared() - radius*radius;
-
-        auto discriminant = half_b*half_b - a*c;
-        if (discriminant < 0)
+        double root;
+        if (!nearest_root(r, ray_t, root))
             return false;
 
-        auto sqrtd = std::sqrt(discriminant);
-
-        auto root = (-half_b - sqrtd) / a;
-        if (!ray_t.surrounds(root)) {
-            root = (-half_b + sqrtd) / a;
-            if (!ray_t.surrounds(root))
-                return false;
-        }
-
         rec.t = root;
         rec.p = r.at(rec.t);
 
         vec3 outward_normal = (rec.p - center) / radius;
         rec.set_face_normal(r, outward_normal);
-        rec.mat_ptr = mat_ptr;
+        rec.mat_ptr = mat_ptr.get();
 
         get_sphere_uv(outward_normal, rec.u, rec.v);
 
         return true;
     }
 
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+        double root;
+        return nearest_root(r, ray_t, root);
+    }
+
     // BOUNDING BOX
     virtual bool bounding_box(
         double time0,
@@ -122,6 +115,35 @@ public:
     point3 center;
     double radius;
     std::shared_ptr<material> mat_ptr;
+
+private:
+    bool nearest_root(
+        const ray& r,
+        const interval& ray_t,
+        double& root
+    ) const {
+
+        vec3 oc = r.origin() - center;
+
+        auto a = r.direction().length_squared();
+        auto half_b = dot(oc, r.direction());
+        auto c = oc.length_squared() - radius*radius;
+
+        auto discriminant = half_b*half_b - a*c;
+        if (discriminant < 0)
+            return false;
+
+        auto sqrtd = std::sqrt(discriminant);
+
+        root = (-half_b - sqrtd) / a;
+        if (!ray_t.surrounds(root)) {
+            root = (-half_b + sqrtd) / a;
+            if (!ray_t.surrounds(root))
+                return false;
+        }
+
+        return true;
+    }
 };
 
 #endif
\ No newline at end of file
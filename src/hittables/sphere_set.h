@@ -0,0 +1,244 @@
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "rtweekend.h"
+#include "hittable.h"
+#include "bvh_builder.h"
+#include "linear_bvh.h"
+#include "sphere.h"
+#include "sphere_packet.h"
+
+// Static spheres behind one hittable, for sphere fields and particle
+// scenes. Centers, radii and material ids are kept in separate arrays
+// instead of one sphere object (and material reference) per sphere.
+// The set carries its own flattened BVH; each leaf's spheres are also
+// stored as SIMD packets, tested a packet at a time, and only the
+// closest hit is turned into a hit_record.
+class sphere_set : public hittable {
+public:
+    sphere_set() {}
+
+    sphere_set(
+        std::vector<point3> _centers,
+        std::vector<double> _radii,
+        std::vector<uint32_t> _material_ids,
+        std::vector<std::shared_ptr<material>> _materials,
+        const bvh_build_options& options = default_build_options()
+    ) : materials(std::move(_materials)) {
+
+        std::vector<aabb> boxes(_centers.size());
+        for (size_t i = 0; i < boxes.size(); i++) {
+            vec3 extent(_radii[i], _radii[i], _radii[i]);
+            boxes[i] = aabb(_centers[i] - extent, _centers[i] + extent);
+        }
+
+        bvh_builder builder(boxes, options);
+        nodes = std::move(builder.nodes);
+
+        // Spheres are stored in leaf order, so a leaf's range indexes
+        // them directly.
+        centers.reserve(_centers.size());
+        radii.reserve(_radii.size());
+        material_ids.reserve(_material_ids.size());
+
+        for (auto i : builder.indices) {
+            centers.push_back(_centers[i]);
+            radii.push_back(_radii[i]);
+            material_ids.push_back(_material_ids[i]);
+        }
+
+        build_packets();
+
+        if (!nodes.empty())
+            box = nodes[0].bounds();
+    }
+
+    // Gathers existing sphere objects, sharing one material entry
+    // between spheres that share a material.
+    sphere_set(
+        const std::vector<std::shared_ptr<sphere>>& spheres,
+        const bvh_build_options& options = default_build_options()
+    ) : sphere_set(gather(spheres), options) {}
+
+    static bvh_build_options default_build_options() {
+        bvh_build_options options;
+        options.split = bvh_split_method::sah;
+        options.parallel = true;
+
+        // A packet tests its spheres for about the price of one, so
+        // leaves are allowed to fill a whole packet.
+        options.max_leaf_size = sphere_packet_width;
+        options.intersection_cost = 0.5;
+        return options;
+    }
+
+    virtual bool hit(
+        const ray& r,
+        const interval& ray_t,
+        hit_record& rec
+    ) const override {
+
+        uint32_t closest = 0;
+        double closest_t = 0;
+
+        bool hit_anything = traverse_linear_bvh(nodes, r, ray_t,
+            [&](uint32_t first, uint32_t count, interval& t) {
+                bool hit_leaf = false;
+                sphere_packet_hits<sphere_packet_width> lanes;
+
+                for (uint32_t p = first; p < first + packets_in(count); p++) {
+                    int mask = sphere_packet_test(packets[p], r, t, lanes);
+
+                    while (mask) {
+                        int k = __builtin_ctz(static_cast<unsigned>(mask));
+                        mask &= mask - 1;
+
+                        double t_hit = lanes.distance(k);
+                        if (t_hit < t.max) {
+                            hit_leaf = true;
+                            t.max = t_hit;
+                            closest = packets[p].sphere[k];
+                            closest_t = t_hit;
+                        }
+                    }
+                }
+
+                return hit_leaf;
+            });
+
+        if (!hit_anything)
+            return false;
+
+        rec.t = closest_t;
+        rec.p = r.at(closest_t);
+
+        vec3 outward_normal = (rec.p - centers[closest]) / radii[closest];
+        rec.set_face_normal(r, outward_normal);
+        rec.mat_ptr = materials[material_ids[closest]].get();
+
+        get_sphere_uv(outward_normal, rec.u, rec.v);
+
+        return true;
+    }
+
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+
+        return traverse_linear_bvh<true>(nodes, r, ray_t,
+            [&](uint32_t first, uint32_t count, interval& t) {
+                sphere_packet_hits<sphere_packet_width> lanes;
+
+                for (uint32_t p = first; p < first + packets_in(count); p++) {
+                    if (sphere_packet_test(packets[p], r, t, lanes))
+                        return true;
+                }
+
+                return false;
+            });
+    }
+
+    virtual bool bounding_box(
+        double time0,
+        double time1,
+        aabb& output_box
+    ) const override {
+        if (nodes.empty())
+            return false;
+
+        output_box = box;
+        return true;
+    }
+
+    size_t size() const { return centers.size(); }
+
+    size_t memory_bytes() const {
+        return centers.size() * sizeof(point3)
+             + radii.size() * sizeof(double)
+             + material_ids.size() * sizeof(uint32_t)
+             + packets.size() * sizeof(sphere_packet<sphere_packet_width>)
+             + nodes.size() * sizeof(linear_bvh_node);
+    }
+
+public:
+    std::vector<point3> centers;
+    std::vector<double> radii;
+    std::vector<uint32_t> material_ids;
+    std::vector<std::shared_ptr<material>> materials;
+    std::vector<linear_bvh_node> nodes;
+    std::vector<sphere_packet<sphere_packet_width>> packets;
+    aabb box;
+
+private:
+    struct gathered {
+        std::vector<point3> centers;
+        std::vector<double> radii;
+        std::vector<uint32_t> material_ids;
+        std::vector<std::shared_ptr<material>> materials;
+    };
+
+    sphere_set(gathered g, const bvh_build_options& options)
+        : sphere_set(std::move(g.centers), std::move(g.radii),
+                     std::move(g.material_ids), std::move(g.materials), options) {}
+
+    static gathered gather(const std::vector<std::shared_ptr<sphere>>& spheres) {
+        gathered g;
+        std::unordered_map<const material*, uint32_t> id_of;
+
+        for (const auto& s : spheres) {
+            auto it = id_of.find(s->mat_ptr.get());
+            if (it == id_of.end()) {
+                it = id_of.emplace(s->mat_ptr.get(), static_cast<uint32_t>(g.materials.size())).first;
+                g.materials.push_back(s->mat_ptr);
+            }
+
+            g.centers.push_back(s->center);
+            g.radii.push_back(s->radius);
+            g.material_ids.push_back(it->second);
+        }
+
+        return g;
+    }
+
+    static uint32_t packets_in(uint32_t count) {
+        return (count + sphere_packet_width - 1) / sphere_packet_width;
+    }
+
+    // Packs each leaf's spheres into packets and points the leaf at its
+    // first packet; leaf counts stay in spheres.
+    void build_packets() {
+        packets.clear();
+
+        for (auto& node : nodes) {
+            if (!node.is_leaf())
+                continue;
+
+            uint32_t first = node.offset;
+            node.offset = static_cast<uint32_t>(packets.size());
+
+            for (uint32_t i = 0; i < node.count; i += sphere_packet_width) {
+                sphere_packet<sphere_packet_width> p = {};
+
+                for (int k = 0; k < sphere_packet_width && i + k < node.count; k++) {
+                    uint32_t index = first + i + k;
+
+                    p.c_x[k] = centers[index].x();
+                    p.c_y[k] = centers[index].y();
+                    p.c_z[k] = centers[index].z();
+                    p.radius[k] = radii[index];
+                    p.sphere[k] = index;
+                    p.valid |= 1 << k;
+                }
+
+                packets.push_back(p);
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <memory>
+#include "hittable.h"
+#include "mat3x4.h"
+
+// Places shared geometry in the world through one affine matrix. The
+// ray is moved into object space once per query, so the geometry (and
+// any BVH inside it) can be shared by any number of instances.
+//
+// Wrapping another instance (translate and rotate_y are instances too)
+// multiplies the two matrices at construction and references the inner
+// geometry directly, so stacked placements cost one transform per hit.
+class transform_instance : public hittable {
+public:
+    transform_instance(
+        std::shared_ptr<hittable> p,
+        const mat3x4& object_to_world
+    ) : ptr(p),
+        to_world(object_to_world) {
+
+        if (auto inner = std::dynamic_pointer_cast<transform_instance>(ptr)) {
+            ptr = inner->ptr;
+            to_world = to_world * inner->to_world;
+        }
+
+        to_object = to_world.inverse();
+    }
+
+    virtual bool hit(
+        const ray& r,
+        const interval& ray_t,
+        hit_record& rec
+    ) const override {
+
+        // The direction is not renormalised, so t is the same in both
+        // spaces and ray_t needs no adjustment.
+        if (!ptr->hit(to_object_ray(r), ray_t, rec))
+            return false;
+
+        rec.p = r.at(rec.t);
+        rec.normal = unit_vector(
+            to_object.transform_normal_transposed(rec.normal));
+
+        return true;
+    }
+
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+        return ptr->occluded(to_object_ray(r), ray_t);
+    }
+
+    virtual bool is_stochastic() const override {
+        return ptr->is_stochastic();
+    }
+
+    virtual bool bounding_box(
+        double time0,
+        double time1,
+        aabb& output_box
+    ) const override {
+
+        // Asked afresh each time: a moving child's box depends on the
+        // shutter interval, and a refit child's box changes over time.
+        aabb object_box;
+        if (!ptr->bounding_box(time0, time1, object_box))
+            return false;
+
+        output_box = to_world.transform_box(object_box);
+        return true;
+    }
+
+    const std::shared_ptr<hittable>& object() const { return ptr; }
+    const mat3x4& object_to_world() const { return to_world; }
+
+private:
+    ray to_object_ray(const ray& r) const {
+        return ray(to_object.transform_point(r.origin()),
+                   to_object.transform_vector(r.direction()),
+                   r.time());
+    }
+
+    std::shared_ptr<hittable> ptr;
+    mat3x4 to_world;
+    mat3x4 to_object;
+};
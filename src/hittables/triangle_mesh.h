@@ -0,0 +1,423 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "rtweekend.h"
+#include "hittable.h"
+#include "bvh_builder.h"
+#include "linear_bvh.h"
+#include "triangle_packet.h"
+
+// Marks a missing normal or texture coordinate in mesh_triangle.
+constexpr uint32_t mesh_no_index = UINT32_MAX;
+
+// One triangle of a mesh, as indices into the mesh's shared buffers.
+// Each corner names its position, normal and texture coordinate
+// separately, as OBJ files do.
+struct mesh_triangle {
+    uint32_t position[3];
+    uint32_t normal[3] = {mesh_no_index, mesh_no_index, mesh_no_index};
+    uint32_t uv[3] = {mesh_no_index, mesh_no_index, mesh_no_index};
+};
+
+struct mesh_uv {
+    double u;
+    double v;
+};
+
+// Contiguous read-only array that either owns its elements or views
+// memory kept alive elsewhere, such as a mapped mesh file.
+template <typename T>
+class mesh_array {
+public:
+    using value_type = T;
+
+    mesh_array() {}
+
+    mesh_array(std::vector<T> elements)
+        : owned(std::move(elements)), first(owned.data()), count(owned.size()) {}
+
+    mesh_array(const T* elements, size_t n)
+        : first(elements), count(n) {}
+
+    // Moving a vector keeps its buffer, so views stay valid.
+    mesh_array(mesh_array&& other) noexcept
+        : owned(std::move(other.owned)), first(other.first), count(other.count) {
+        other.first = nullptr;
+        other.count = 0;
+    }
+
+    mesh_array& operator=(mesh_array&& other) noexcept {
+        owned = std::move(other.owned);
+        first = other.first;
+        count = other.count;
+        other.first = nullptr;
+        other.count = 0;
+        return *this;
+    }
+
+    mesh_array(const mesh_array&) = delete;
+    mesh_array& operator=(const mesh_array&) = delete;
+
+    const T& operator[](size_t i) const { return first[i]; }
+    const T* data() const { return first; }
+    const T* begin() const { return first; }
+    const T* end() const { return first + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Heap bytes owned by this array; zero for a view.
+    size_t heap_bytes() const { return owned.size() * sizeof(T); }
+
+private:
+    std::vector<T> owned;
+    const T* first = nullptr;
+    size_t count = 0;
+};
+
+using mesh_packet = triangle_packet<triangle_packet_width>;
+
+// Scene materials by the names mesh files give them.
+using mesh_material_table = std::unordered_map<std::string, std::shared_ptr<material>>;
+
+// Looks up a mesh's named materials, by id, falling back to `fallback`
+// for names the table lacks. A mesh without names gets just `fallback`.
+inline std::vector<std::shared_ptr<material>> resolve_mesh_materials(
+    const std::vector<std::string>& names,
+    std::shared_ptr<material> fallback,
+    const mesh_material_table& table
+) {
+    std::vector<std::shared_ptr<material>> materials;
+
+    for (const auto& name : names) {
+        auto it = table.find(name);
+        materials.push_back(it != table.end() ? it->second : fallback);
+    }
+
+    if (materials.empty())
+        materials.push_back(fallback);
+
+    return materials;
+}
+
+// Indexed triangle mesh. Vertex data lives in contiguous buffers shared
+// by all triangles, and the mesh carries its own flattened BVH over the
+// triangles, so a scene BVH sees it as a single primitive however many
+// triangles it has. Each leaf's triangles are also stored as SIMD
+// packets, tested a packet at a time; only the closest hit is turned
+// into a hit_record.
+//
+// Normals, where given, are interpolated for shading; which side was
+// hit is still decided by the geometric normal. Texture coordinates
+// default to the barycentric coordinates of the hit. Triangles may
+// carry material ids into the mesh's material list; without them the
+// first material is used throughout.
+//
+// The arrays may also view memory owned elsewhere (see mesh_file.h),
+// in which case `storage` keeps that memory alive.
+class triangle_mesh : public hittable {
+public:
+    triangle_mesh() {}
+
+    triangle_mesh(
+        std::vector<point3> _positions,
+        std::vector<vec3> _normals,
+        std::vector<mesh_uv> _uvs,
+        std::vector<mesh_triangle> _triangles,
+        std::shared_ptr<material> m,
+        const bvh_build_options& options = default_build_options()
+    ) : triangle_mesh(std::move(_positions), std::move(_normals), std::move(_uvs),
+                      std::move(_triangles), {}, {m}, options) {}
+
+    triangle_mesh(
+        std::vector<point3> _positions,
+        std::vector<vec3> _normals,
+        std::vector<mesh_uv> _uvs,
+        std::vector<mesh_triangle> _triangles,
+        std::vector<uint32_t> _material_ids,
+        std::vector<std::shared_ptr<material>> _materials,
+        const bvh_build_options& options = default_build_options()
+    ) : positions(std::move(_positions)),
+        normals(std::move(_normals)),
+        uvs(std::move(_uvs)),
+        materials(std::move(_materials)) {
+
+        std::vector<aabb> boxes(_triangles.size());
+        for (size_t i = 0; i < boxes.size(); i++)
+            boxes[i] = triangle_box(_triangles[i]);
+
+        bvh_builder builder(boxes, options);
+
+        // Triangles are stored in leaf order, so a leaf's range indexes
+        // them directly.
+        std::vector<mesh_triangle> sorted;
+        std::vector<uint32_t> sorted_ids;
+        sorted.reserve(_triangles.size());
+
+        for (auto i : builder.indices) {
+            sorted.push_back(_triangles[i]);
+            if (!_material_ids.empty())
+                sorted_ids.push_back(_material_ids[i]);
+        }
+
+        triangles = std::move(sorted);
+        material_ids = std::move(sorted_ids);
+
+        packets = build_packets(builder.nodes);
+        nodes = std::move(builder.nodes);
+
+        if (!nodes.empty())
+            box = nodes[0].bounds();
+    }
+
+    // Adopts arrays prepared earlier, typically views into a mapped
+    // mesh file. Triangles must be in the leaf order of `_nodes`, and
+    // each leaf must point at its packets.
+    triangle_mesh(
+        mesh_array<point3> _positions,
+        mesh_array<vec3> _normals,
+        mesh_array<mesh_uv> _uvs,
+        mesh_array<mesh_triangle> _triangles,
+        mesh_array<uint32_t> _material_ids,
+        mesh_array<linear_bvh_node> _nodes,
+        mesh_array<mesh_packet> _packets,
+        std::vector<std::shared_ptr<material>> _materials,
+        std::shared_ptr<const void> _storage
+    ) : positions(std::move(_positions)),
+        normals(std::move(_normals)),
+        uvs(std::move(_uvs)),
+        triangles(std::move(_triangles)),
+        material_ids(std::move(_material_ids)),
+        nodes(std::move(_nodes)),
+        packets(std::move(_packets)),
+        materials(std::move(_materials)),
+        storage(std::move(_storage)) {
+
+        if (!nodes.empty())
+            box = nodes[0].bounds();
+    }
+
+    static bvh_build_options default_build_options() {
+        bvh_build_options options;
+        options.split = bvh_split_method::sah;
+        options.parallel = true;
+
+        // A packet tests its triangles for about the price of one, so
+        // leaves are allowed to fill a whole packet.
+        options.max_leaf_size = triangle_packet_width;
+        options.intersection_cost = 0.5;
+        return options;
+    }
+
+    virtual bool hit(
+        const ray& r,
+        const interval& ray_t,
+        hit_record& rec
+    ) const override {
+
+        uint32_t closest = 0;
+        double closest_t = 0, b1 = 0, b2 = 0;
+
+        bool hit_anything = traverse_linear_bvh(nodes, r, ray_t,
+            [&](uint32_t first, uint32_t count, interval& t) {
+                bool hit_leaf = false;
+                triangle_packet_hits<triangle_packet_width> lanes;
+
+                for (uint32_t p = first; p < first + packets_in(count); p++) {
+                    int mask = triangle_packet_test(packets[p], r, t, lanes);
+
+                    while (mask) {
+                        int k = __builtin_ctz(static_cast<unsigned>(mask));
+                        mask &= mask - 1;
+
+                        double t_hit = lanes.distance(k);
+                        if (t_hit < t.max) {
+                            hit_leaf = true;
+                            t.max = t_hit;
+                            closest = packets[p].triangle[k];
+                            closest_t = t_hit;
+                            b1 = lanes.b1(k);
+                            b2 = lanes.b2(k);
+                        }
+                    }
+                }
+
+                return hit_leaf;
+            });
+
+        if (!hit_anything)
+            return false;
+
+        fill_record(closest, r, closest_t, b1, b2, rec);
+        return true;
+    }
+
+    virtual bool occluded(
+        const ray& r,
+        const interval& ray_t
+    ) const override {
+
+        return traverse_linear_bvh<true>(nodes, r, ray_t,
+            [&](uint32_t first, uint32_t count, interval& t) {
+                triangle_packet_hits<triangle_packet_width> lanes;
+
+                for (uint32_t p = first; p < first + packets_in(count); p++) {
+                    if (triangle_packet_test(packets[p], r, t, lanes))
+                        return true;
+                }
+
+                return false;
+            });
+    }
+
+    virtual bool bounding_box(
+        double time0,
+        double time1,
+        aabb& output_box
+    ) const override {
+        if (nodes.empty())
+            return false;
+
+        output_box = box;
+        return true;
+    }
+
+    size_t triangle_count() const { return triangles.size(); }
+
+    // Heap memory held by the mesh. Arrays viewing a mapped file are
+    // not counted; their pages are shared through the page cache.
+    size_t memory_bytes() const {
+        return positions.heap_bytes()
+             + normals.heap_bytes()
+             + uvs.heap_bytes()
+             + triangles.heap_bytes()
+             + material_ids.heap_bytes()
+             + packets.heap_bytes()
+             + nodes.heap_bytes();
+    }
+
+public:
+    mesh_array<point3> positions;
+    mesh_array<vec3> normals;
+    mesh_array<mesh_uv> uvs;
+    mesh_array<mesh_triangle> triangles;
+    mesh_array<uint32_t> material_ids;   // per triangle; may be empty
+    mesh_array<linear_bvh_node> nodes;
+    mesh_array<mesh_packet> packets;
+    std::vector<std::shared_ptr<material>> materials;
+    std::shared_ptr<const void> storage;
+    aabb box;
+
+private:
+    static uint32_t packets_in(uint32_t count) {
+        return (count + triangle_packet_width - 1) / triangle_packet_width;
+    }
+
+    // Packs each leaf's triangles into packets and points the leaf at
+    // its first packet; leaf counts stay in triangles.
+    std::vector<mesh_packet> build_packets(std::vector<linear_bvh_node>& leaf_nodes) const {
+        std::vector<mesh_packet> packets;
+
+        for (auto& node : leaf_nodes) {
+            if (!node.is_leaf())
+                continue;
+
+            uint32_t first = node.offset;
+            node.offset = static_cast<uint32_t>(packets.size());
+
+            for (uint32_t i = 0; i < node.count; i += triangle_packet_width) {
+                mesh_packet p = {};
+
+                for (int k = 0; k < triangle_packet_width && i + k < node.count; k++) {
+                    uint32_t index = first + i + k;
+                    const mesh_triangle& tri = triangles[index];
+
+                    const point3& v0 = positions[tri.position[0]];
+                    vec3 e1 = positions[tri.position[1]] - v0;
+                    vec3 e2 = positions[tri.position[2]] - v0;
+
+                    p.v0_x[k] = v0.x(); p.v0_y[k] = v0.y(); p.v0_z[k] = v0.z();
+                    p.e1_x[k] = e1.x(); p.e1_y[k] = e1.y(); p.e1_z[k] = e1.z();
+                    p.e2_x[k] = e2.x(); p.e2_y[k] = e2.y(); p.e2_z[k] = e2.z();
+                    p.triangle[k] = index;
+                    p.valid |= 1 << k;
+                }
+
+                packets.push_back(p);
+            }
+        }
+
+        return packets;
+    }
+
+    // Axis-aligned triangles get the same thickness as the rects, so
+    // their boxes never have zero width.
+    aabb triangle_box(const mesh_triangle& tri) const {
+        const point3& p0 = positions[tri.position[0]];
+        const point3& p1 = positions[tri.position[1]];
+        const point3& p2 = positions[tri.position[2]];
+
+        point3 lo, hi;
+        for (int a = 0; a < 3; a++) {
+            lo[a] = fmin(p0[a], fmin(p1[a], p2[a]));
+            hi[a] = fmax(p0[a], fmax(p1[a], p2[a]));
+
+            if (hi[a] - lo[a] < 0.0002) {
+                lo[a] -= 0.0001;
+                hi[a] += 0.0001;
+            }
+        }
+
+        return aabb(lo, hi);
+    }
+
+    void fill_record(
+        uint32_t index,
+        const ray& r,
+        double t,
+        double b1,
+        double b2,
+        hit_record& rec
+    ) const {
+        const mesh_triangle& tri = triangles[index];
+        const point3& p0 = positions[tri.position[0]];
+        const point3& p1 = positions[tri.position[1]];
+        const point3& p2 = positions[tri.position[2]];
+        double b0 = 1 - b1 - b2;
+
+        rec.t = t;
+        rec.p = r.at(t);
+
+        vec3 geometric = unit_vector(cross(p1 - p0, p2 - p0));
+        rec.front_face = dot(r.direction(), geometric) < 0;
+
+        vec3 shading = geometric;
+        if (tri.normal[0] != mesh_no_index) {
+            shading = unit_vector(b0 * normals[tri.normal[0]]
+                                + b1 * normals[tri.normal[1]]
+                                + b2 * normals[tri.normal[2]]);
+        }
+
+        rec.normal = rec.front_face ? shading : -shading;
+
+        if (tri.uv[0] != mesh_no_index) {
+            const mesh_uv& t0 = uvs[tri.uv[0]];
+            const mesh_uv& t1 = uvs[tri.uv[1]];
+            const mesh_uv& t2 = uvs[tri.uv[2]];
+            rec.u = b0 * t0.u + b1 * t1.u + b2 * t2.u;
+            rec.v = b0 * t0.v + b1 * t1.v + b2 * t2.v;
+        } else {
+            rec.u = b1;
+            rec.v = b2;
+        }
+
+        rec.mat_ptr = materials[material_ids.empty() ? 0 : material_ids[index]].get();
+    }
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define RT_MAPPED_FILE_MMAP 1
+#endif
+
+// Read-only view of a whole file: memory-mapped where the platform
+// allows it, read into a buffer otherwise. Mapped pages come from the
+// page cache, so processes mapping the same file share one copy.
+class mapped_file {
+public:
+    explicit mapped_file(const std::filesystem::path& path) {
+#ifdef RT_MAPPED_FILE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* mapped = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                bytes = static_cast<const unsigned char*>(mapped);
+                length = static_cast<size_t>(st.st_size);
+            }
+        }
+
+        ::close(fd);
+#else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in)
+            return;
+
+        // Whole blocks keep the buffer aligned like a mapping would be.
+        size_t size = static_cast<size_t>(in.tellg());
+        buffer.resize((size + sizeof(block) - 1) / sizeof(block));
+        in.seekg(0);
+        if (in.read(reinterpret_cast<char*>(buffer.data()), size)) {
+            bytes = reinterpret_cast<const unsigned char*>(buffer.data());
+            length = size;
+        }
+#endif
+    }
+
+    ~mapped_file() {
+#ifdef RT_MAPPED_FILE_MMAP
+        if (bytes)
+            ::munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+#ifndef RT_MAPPED_FILE_MMAP
+    struct alignas(64) block { unsigned char bytes[64]; };
+    std::vector<block> buffer;
+#endif
+};
+
+#endif
@@ -0,0 +1,320 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "rtweekend.h"
+#include "triangle_mesh.h"
+#include "mapped_file.h"
+#include "obj_loader.h"
+
+// Binary mesh format, laid out so a mapped file can back a
+// triangle_mesh directly. After the header come the mesh's arrays
+// exactly as they sit in memory, each starting on a 64-byte boundary:
+// positions, normals, texture coordinates, triangles, per-triangle
+// material ids, material names ('\0'-terminated, by id) and, when the
+// file carries a prebuilt BVH, its nodes and triangle packets.
+//
+// Loading a file with a BVH copies nothing: the mesh views the mapping,
+// and render processes using the same asset share its pages. Files are
+// written in the machine's own byte order and struct layout; the header
+// records the element sizes so a mismatched build rejects the file.
+enum mesh_file_section : uint32_t {
+    mesh_section_positions,
+    mesh_section_normals,
+    mesh_section_uvs,
+    mesh_section_triangles,
+    mesh_section_material_ids,
+    mesh_section_material_names,
+    mesh_section_nodes,
+    mesh_section_packets,
+    mesh_section_count
+};
+
+struct mesh_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t packet_width;
+    uint32_t element_size[mesh_section_count];
+
+    // Byte offset and element count of each section.
+    uint64_t offset[mesh_section_count];
+    uint64_t count[mesh_section_count];
+};
+
+constexpr char mesh_file_magic[8] = {'R', 'T', 'M', 'E', 'S', 'H', 'B', 'N'};
+constexpr uint32_t mesh_file_version = 1;
+constexpr uint64_t mesh_file_alignment = 64;
+
+inline void mesh_file_element_sizes(uint32_t (&sizes)[mesh_section_count]) {
+    sizes[mesh_section_positions] = sizeof(point3);
+    sizes[mesh_section_normals] = sizeof(vec3);
+    sizes[mesh_section_uvs] = sizeof(mesh_uv);
+    sizes[mesh_section_triangles] = sizeof(mesh_triangle);
+    sizes[mesh_section_material_ids] = sizeof(uint32_t);
+    sizes[mesh_section_material_names] = sizeof(char);
+    sizes[mesh_section_nodes] = sizeof(linear_bvh_node);
+    sizes[mesh_section_packets] = sizeof(mesh_packet);
+}
+
+template <typename T>
+const T* mesh_file_section_data(
+    const mesh_file_header& header,
+    const unsigned char* bytes,
+    mesh_file_section s
+) {
+    return reinterpret_cast<const T*>(bytes + header.offset[s]);
+}
+
+// Writes `mesh` to `path`, with its BVH unless include_bvh is false.
+// material_names, if given, names the mesh's material ids. The file is
+// written under a temporary name and renamed, so readers never see a
+// partial one.
+inline bool save_mesh_file(
+    const triangle_mesh& mesh,
+    const std::vector<std::string>& material_names,
+    const std::filesystem::path& path,
+    bool include_bvh = true
+) {
+    std::string names;
+    for (const auto& name : material_names) {
+        names += name;
+        names += '\0';
+    }
+
+    const void* data[mesh_section_count] = {
+        mesh.positions.data(), mesh.normals.data(), mesh.uvs.data(),
+        mesh.triangles.data(), mesh.material_ids.data(), names.data(),
+        mesh.nodes.data(), mesh.packets.data()
+    };
+
+    mesh_file_header header = {};
+    std::memcpy(header.magic, mesh_file_magic, sizeof(header.magic));
+    header.version = mesh_file_version;
+    header.packet_width = triangle_packet_width;
+    mesh_file_element_sizes(header.element_size);
+
+    header.count[mesh_section_positions] = mesh.positions.size();
+    header.count[mesh_section_normals] = mesh.normals.size();
+    header.count[mesh_section_uvs] = mesh.uvs.size();
+    header.count[mesh_section_triangles] = mesh.triangles.size();
+    header.count[mesh_section_material_ids] = mesh.material_ids.size();
+    header.count[mesh_section_material_names] = names.size();
+    header.count[mesh_section_nodes] = include_bvh ? mesh.nodes.size() : 0;
+    header.count[mesh_section_packets] = include_bvh ? mesh.packets.size() : 0;
+
+    uint64_t position = sizeof(header);
+    for (uint32_t s = 0; s < mesh_section_count; s++) {
+        position = (position + mesh_file_alignment - 1) / mesh_file_alignment * mesh_file_alignment;
+        header.offset[s] = position;
+        position += header.count[s] * header.element_size[s];
+    }
+
+    std::filesystem::path temp = path;
+    temp += ".tmp";
+
+    {
+        std::ofstream out(temp, std::ios::binary);
+        if (!out)
+            return false;
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        for (uint32_t s = 0; s < mesh_section_count; s++) {
+            const char zeros[mesh_file_alignment] = {};
+            out.write(zeros, header.offset[s] - static_cast<uint64_t>(out.tellp()));
+            out.write(static_cast<const char*>(data[s]),
+                      header.count[s] * header.element_size[s]);
+        }
+
+        if (!out)
+            return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp, path, error);
+    return !error;
+}
+
+// Checks everything traversal and shading index with, so a damaged or
+// foreign file is rejected rather than read out of bounds.
+inline bool mesh_file_is_valid(
+    const mesh_file_header& header,
+    const unsigned char* bytes,
+    size_t size
+) {
+    uint32_t sizes[mesh_section_count];
+    mesh_file_element_sizes(sizes);
+
+    if (std::memcmp(header.magic, mesh_file_magic, sizeof(header.magic)) != 0
+     || header.version != mesh_file_version
+     || header.packet_width != triangle_packet_width
+     || std::memcmp(header.element_size, sizes, sizeof(sizes)) != 0)
+        return false;
+
+    for (uint32_t s = 0; s < mesh_section_count; s++) {
+        if (header.offset[s] % mesh_file_alignment != 0
+         || header.offset[s] > size
+         || header.count[s] > (size - header.offset[s]) / sizes[s])
+            return false;
+    }
+
+    const uint64_t* count = header.count;
+
+    auto triangles = mesh_file_section_data<mesh_triangle>(header, bytes, mesh_section_triangles);
+    for (uint64_t i = 0; i < count[mesh_section_triangles]; i++) {
+        const mesh_triangle& tri = triangles[i];
+        for (int j = 0; j < 3; j++) {
+            if (tri.position[j] >= count[mesh_section_positions])
+                return false;
+            if (tri.normal[0] != mesh_no_index && tri.normal[j] >= count[mesh_section_normals])
+                return false;
+            if (tri.uv[0] != mesh_no_index && tri.uv[j] >= count[mesh_section_uvs])
+                return false;
+        }
+    }
+
+    auto names = mesh_file_section_data<char>(header, bytes, mesh_section_material_names);
+    uint64_t name_count = 0;
+    for (uint64_t i = 0; i < count[mesh_section_material_names]; i++)
+        name_count += names[i] == '\0';
+
+    if (count[mesh_section_material_names] > 0 && names[count[mesh_section_material_names] - 1] != '\0')
+        return false;
+
+    if (count[mesh_section_material_ids] != 0) {
+        if (count[mesh_section_material_ids] != count[mesh_section_triangles])
+            return false;
+
+        auto ids = mesh_file_section_data<uint32_t>(header, bytes, mesh_section_material_ids);
+        for (uint64_t i = 0; i < count[mesh_section_material_ids]; i++) {
+            if (ids[i] >= name_count)
+                return false;
+        }
+    }
+
+    auto packets = mesh_file_section_data<mesh_packet>(header, bytes, mesh_section_packets);
+    for (uint64_t i = 0; i < count[mesh_section_packets]; i++) {
+        for (int k = 0; k < triangle_packet_width; k++) {
+            if ((packets[i].valid >> k & 1) && packets[i].triangle[k] >= count[mesh_section_triangles])
+                return false;
+        }
+    }
+
+    auto nodes = mesh_file_section_data<linear_bvh_node>(header, bytes, mesh_section_nodes);
+    auto leaf_valid = [&](uint32_t offset, uint32_t triangles) {
+        uint64_t packet_count = (uint64_t(triangles) + triangle_packet_width - 1) / triangle_packet_width;
+        return offset + packet_count <= count[mesh_section_packets];
+    };
+
+    return linear_bvh_nodes_valid(nodes, count[mesh_section_nodes], leaf_valid);
+}
+
+// Loads a mesh written by save_mesh_file. Material names are looked up
+// in `table`, with `m` standing in for any it lacks. A file without a
+// BVH is copied out and built with `options`; one with a BVH is used in
+// place, and `options` is ignored. Returns nullptr for a missing or
+// invalid file.
+inline std::shared_ptr<triangle_mesh> load_mesh_file(
+    const std::filesystem::path& path,
+    std::shared_ptr<material> m,
+    const mesh_material_table& table = mesh_material_table(),
+    const bvh_build_options& options = triangle_mesh::default_build_options()
+) {
+    auto file = std::make_shared<const mapped_file>(path);
+    if (!file->data() || file->size() < sizeof(mesh_file_header)) {
+        std::cerr << "Could not open mesh file " << path << "\n";
+        return nullptr;
+    }
+
+    mesh_file_header header;
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    if (!mesh_file_is_valid(header, file->data(), file->size())) {
+        std::cerr << "Invalid mesh file " << path << "\n";
+        return nullptr;
+    }
+
+    const unsigned char* bytes = file->data();
+    const uint64_t* count = header.count;
+
+    auto positions = mesh_file_section_data<point3>(header, bytes, mesh_section_positions);
+    auto normals = mesh_file_section_data<vec3>(header, bytes, mesh_section_normals);
+    auto uvs = mesh_file_section_data<mesh_uv>(header, bytes, mesh_section_uvs);
+    auto triangles = mesh_file_section_data<mesh_triangle>(header, bytes, mesh_section_triangles);
+    auto ids = mesh_file_section_data<uint32_t>(header, bytes, mesh_section_material_ids);
+
+    std::vector<std::string> names;
+    auto name = mesh_file_section_data<char>(header, bytes, mesh_section_material_names);
+    auto names_end = name + count[mesh_section_material_names];
+    while (name < names_end) {
+        names.emplace_back(name);
+        name += names.back().size() + 1;
+    }
+
+    auto materials = resolve_mesh_materials(names, m, table);
+
+    if (count[mesh_section_nodes] == 0) {
+        return std::make_shared<triangle_mesh>(
+            std::vector<point3>(positions, positions + count[mesh_section_positions]),
+            std::vector<vec3>(normals, normals + count[mesh_section_normals]),
+            std::vector<mesh_uv>(uvs, uvs + count[mesh_section_uvs]),
+            std::vector<mesh_triangle>(triangles, triangles + count[mesh_section_triangles]),
+            std::vector<uint32_t>(ids, ids + count[mesh_section_material_ids]),
+            std::move(materials),
+            options);
+    }
+
+    return std::make_shared<triangle_mesh>(
+        mesh_array<point3>(positions, count[mesh_section_positions]),
+        mesh_array<vec3>(normals, count[mesh_section_normals]),
+        mesh_array<mesh_uv>(uvs, count[mesh_section_uvs]),
+        mesh_array<mesh_triangle>(triangles, count[mesh_section_triangles]),
+        mesh_array<uint32_t>(ids, count[mesh_section_material_ids]),
+        mesh_array<linear_bvh_node>(
+            mesh_file_section_data<linear_bvh_node>(header, bytes, mesh_section_nodes),
+            count[mesh_section_nodes]),
+        mesh_array<mesh_packet>(
+            mesh_file_section_data<mesh_packet>(header, bytes, mesh_section_packets),
+            count[mesh_section_packets]),
+        std::move(materials),
+        file);
+}
+
+// Converts an OBJ file to the binary format, building its BVH with
+// `options` unless include_bvh is false.
+inline bool convert_obj_to_mesh_file(
+    const std::filesystem::path& obj_path,
+    const std::filesystem::path& mesh_path,
+    bool include_bvh = true,
+    const bvh_build_options& options = triangle_mesh::default_build_options()
+) {
+    obj_geometry geometry;
+    if (!obj_loader::read(obj_path, geometry))
+        return false;
+
+    // Materials are resolved when the file is loaded; placeholders keep
+    // the ids valid until then.
+    std::vector<std::shared_ptr<material>> placeholders(
+        std::max<size_t>(geometry.material_names.size(), 1));
+
+    triangle_mesh mesh(
+        std::move(geometry.positions),
+        std::move(geometry.normals),
+        std::move(geometry.uvs),
+        std::move(geometry.triangles),
+        std::move(geometry.material_ids),
+        std::move(placeholders),
+        options);
+
+    return save_mesh_file(mesh, geometry.material_names, mesh_path, include_bvh);
+}
+
+#endif
@@ -0,0 +1,340 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "rtweekend.h"
+#include "triangle_mesh.h"
+
+// Mesh data read from an OBJ file, before any BVH is built.
+struct obj_geometry {
+    std::vector<point3> positions;
+    std::vector<vec3> normals;
+    std::vector<mesh_uv> uvs;
+    std::vector<mesh_triangle> triangles;
+
+    // Per triangle, indexing material_names. Both are empty when the
+    // file names no materials; otherwise name 0 is "" and stands for
+    // faces before the first usemtl.
+    std::vector<uint32_t> material_ids;
+    std::vector<std::string> material_names;
+};
+
+// Reads the geometry of a Wavefront OBJ file into one triangle_mesh:
+// v, vt and vn records and f records in any of the v, v/vt, v//vn and
+// v/vt/vn forms, with negative (relative) indices. Polygons are split
+// into triangle fans. usemtl names are looked up in a material table,
+// with `m` standing in for any it lacks; groups, smoothing groups and
+// mtllib files are ignored.
+//
+// The file is read into memory in one piece and parsed in place with
+// std::from_chars, which keeps million-triangle files to a fraction of
+// their BVH build time.
+class obj_loader {
+public:
+    static std::shared_ptr<triangle_mesh> load(
+        const std::filesystem::path& path,
+        std::shared_ptr<material> m,
+        const bvh_build_options& options = triangle_mesh::default_build_options()
+    ) {
+        return load(path, m, mesh_material_table(), options);
+    }
+
+    static std::shared_ptr<triangle_mesh> load(
+        const std::filesystem::path& path,
+        std::shared_ptr<material> m,
+        const mesh_material_table& table,
+        const bvh_build_options& options = triangle_mesh::default_build_options()
+    ) {
+        obj_geometry geometry;
+        if (!read(path, geometry))
+            return nullptr;
+
+        auto materials = resolve_mesh_materials(geometry.material_names, m, table);
+
+        return std::make_shared<triangle_mesh>(
+            std::move(geometry.positions),
+            std::move(geometry.normals),
+            std::move(geometry.uvs),
+            std::move(geometry.triangles),
+            std::move(geometry.material_ids),
+            std::move(materials),
+            options);
+    }
+
+    static bool read(const std::filesystem::path& path, obj_geometry& geometry) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) {
+            std::cerr << "Could not open OBJ file " << path << "\n";
+            return false;
+        }
+
+        std::string text(static_cast<size_t>(in.tellg()), '\0');
+        in.seekg(0);
+        in.read(text.data(), text.size());
+
+        obj_loader loader(text.data(), text.data() + text.size(), geometry);
+        if (!loader.parse()) {
+            std::cerr << "Malformed OBJ file " << path
+                      << " at line " << loader.line << "\n";
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+    const char* cursor;
+    const char* end;
+    size_t line = 1;
+
+    std::vector<point3>& positions;
+    std::vector<vec3>& normals;
+    std::vector<mesh_uv>& uvs;
+    std::vector<mesh_triangle>& triangles;
+    std::vector<uint32_t>& material_ids;
+    std::vector<std::string>& material_names;
+    uint32_t current_material = 0;
+
+    struct corner {
+        uint32_t position;
+        uint32_t uv;
+        uint32_t normal;
+    };
+
+    std::vector<corner> face;
+
+    obj_loader(const char* begin, const char* _end, obj_geometry& geometry)
+        : cursor(begin), end(_end),
+          positions(geometry.positions),
+          normals(geometry.normals),
+          uvs(geometry.uvs),
+          triangles(geometry.triangles),
+          material_ids(geometry.material_ids),
+          material_names(geometry.material_names) {}
+
+    bool parse() {
+        while (cursor < end) {
+            skip_spaces();
+
+            if (at_line_end()) {
+                next_line();
+                continue;
+            }
+
+            bool ok = true;
+
+            if (keyword("v"))
+                ok = read_position();
+            else if (keyword("vn"))
+                ok = read_normal();
+            else if (keyword("vt"))
+                ok = read_uv();
+            else if (keyword("f"))
+                ok = read_face();
+            else if (keyword("usemtl"))
+                ok = read_material();
+
+            if (!ok)
+                return false;
+
+            next_line();
+        }
+
+        return true;
+    }
+
+    bool read_position() {
+        double x, y, z;
+        if (!number(x) || !number(y) || !number(z))
+            return false;
+
+        positions.emplace_back(x, y, z);
+        return true;
+    }
+
+    bool read_normal() {
+        double x, y, z;
+        if (!number(x) || !number(y) || !number(z))
+            return false;
+
+        normals.emplace_back(x, y, z);
+        return true;
+    }
+
+    bool read_uv() {
+        double u, v = 0;
+        if (!number(u))
+            return false;
+
+        // The second coordinate is optional, the third unused.
+        skip_spaces();
+        if (!at_line_end())
+            number(v);
+
+        uvs.push_back({u, v});
+        return true;
+    }
+
+    bool read_material() {
+        skip_spaces();
+
+        const char* start = cursor;
+        while (!at_line_end())
+            cursor++;
+
+        std::string name(start, cursor);
+        while (!name.empty() && (name.back() == ' ' || name.back() == '\t'))
+            name.pop_back();
+
+        // The first usemtl gives every earlier face the unnamed id 0.
+        if (material_names.empty()) {
+            material_names.push_back("");
+            material_ids.assign(triangles.size(), 0);
+        }
+
+        auto it = std::find(material_names.begin(), material_names.end(), name);
+        current_material = static_cast<uint32_t>(it - material_names.begin());
+        if (it == material_names.end())
+            material_names.push_back(name);
+
+        return true;
+    }
+
+    bool read_face() {
+        face.clear();
+
+        while (true) {
+            skip_spaces();
+            if (at_line_end())
+                break;
+
+            corner c = {mesh_no_index, mesh_no_index, mesh_no_index};
+
+            if (!index(positions.size(), c.position))
+                return false;
+
+            if (cursor < end && *cursor == '/') {
+                cursor++;
+                if (cursor < end && *cursor != '/') {
+                    if (!index(uvs.size(), c.uv))
+                        return false;
+                }
+
+                if (cursor < end && *cursor == '/') {
+                    cursor++;
+                    if (!index(normals.size(), c.normal))
+                        return false;
+                }
+            }
+
+            face.push_back(c);
+        }
+
+        if (face.size() < 3)
+            return false;
+
+        for (size_t k = 1; k + 1 < face.size(); k++) {
+            const corner* fan[3] = { &face[0], &face[k], &face[k + 1] };
+            mesh_triangle tri;
+
+            for (int j = 0; j < 3; j++) {
+                tri.position[j] = fan[j]->position;
+                tri.uv[j] = fan[j]->uv;
+                tri.normal[j] = fan[j]->normal;
+            }
+
+            // Corners must all have an attribute for it to be used.
+            if (tri.uv[0] == mesh_no_index || tri.uv[1] == mesh_no_index
+             || tri.uv[2] == mesh_no_index)
+                tri.uv[0] = tri.uv[1] = tri.uv[2] = mesh_no_index;
+
+            if (tri.normal[0] == mesh_no_index || tri.normal[1] == mesh_no_index
+             || tri.normal[2] == mesh_no_index)
+                tri.normal[0] = tri.normal[1] = tri.normal[2] = mesh_no_index;
+
+            triangles.push_back(tri);
+            if (!material_names.empty())
+                material_ids.push_back(current_material);
+        }
+
+        return true;
+    }
+
+    // Reads a 1-based (or negative, counting back from the last
+    // element read) index into a buffer of `count` elements.
+    bool index(size_t count, uint32_t& out) {
+        long long i;
+        auto result = std::from_chars(cursor, end, i);
+        if (result.ec != std::errc())
+            return false;
+        cursor = result.ptr;
+
+        long long resolved = (i < 0) ? static_cast<long long>(count) + i : i - 1;
+        if (resolved < 0 || resolved >= static_cast<long long>(count))
+            return false;
+
+        out = static_cast<uint32_t>(resolved);
+        return true;
+    }
+
+    bool number(double& out) {
+        skip_spaces();
+
+        // from_chars rejects a leading '+', which some exporters write.
+        if (cursor < end && *cursor == '+')
+            cursor++;
+
+        auto result = std::from_chars(cursor, end, out);
+        if (result.ec != std::errc())
+            return false;
+
+        cursor = result.ptr;
+        return true;
+    }
+
+    // Consumes `word` if the line continues with it followed by a space.
+    bool keyword(const char* word) {
+        const char* p = cursor;
+        while (*word) {
+            if (p == end || *p != *word)
+                return false;
+            p++;
+            word++;
+        }
+
+        if (p != end && *p != ' ' && *p != '\t')
+            return false;
+
+        cursor = p;
+        return true;
+    }
+
+    void skip_spaces() {
+        while (cursor < end && (*cursor == ' ' || *cursor == '\t'))
+            cursor++;
+    }
+
+    bool at_line_end() const {
+        return cursor == end || *cursor == '\n' || *cursor == '\r' || *cursor == '#';
+    }
+
+    void next_line() {
+        while (cursor < end && *cursor != '\n')
+            cursor++;
+
+        if (cursor < end) {
+            cursor++;
+            line++;
+        }
+    }
+};
+
+#endif
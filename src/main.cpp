@@ -6,14 +6,25 @@
 #include <omp.h>
 #include <atomic>
 #include <algorithm>
+#include <chrono>
 #include "hittable_list.h"
 #include "hittable_pdf.h"
 #include "mixture_pdf.h"
 #include "camera.h"
 #include "bvh.h"
+#include "linear_bvh.h"
+#include "motion_bvh.h"
+#include "wide_bvh.h"
+#include "quantized_bvh.h"
+#include "bvh_stats.h"
+#include "bvh_counters.h"
+#include "alloc_counter.h"
+#include "bvh_cache.h"
+#include "two_level.h"
 #include "core/interval.h"
 #include "constant_medium.h"
 #include <sphere.h>
+#include "moving_sphere.h"
 
 #include "xy_rect.h"
 #include "xz_rect.h"
@@ -22,6 +33,14 @@
 #include "box.h"
 #include "translate.h"
 #include "rotate_y.h"
+#include "transform_instance.h"
+#include "quad.h"
+#include "quad_set.h"
+#include "sphere_set.h"
+#include "sdf_hittable.h"
+#include "triangle_mesh.h"
+#include "obj_loader.h"
+#include "mesh_file.h"
 
 #include "material.h"
 #include "diffuse_light.h"
@@ -38,6 +57,8 @@ color ray_color(
     if (depth <= 0)
         return color(0,0,0);
 
+    RT_BVH_COUNT(rays, 1);
+
     if (!world.hit(r, interval(0.001, infinity), rec))
         return background;
 
@@ -76,10 +97,8 @@ color ray_color(
         srec.attenuation /= survival_prob;
     }
 
-    auto light_pdf =
-        make_shared<hittable_pdf>(lights, rec.p);
-
-    mixture_pdf mixed_pdf(light_pdf, srec.pdf_ptr);
+    hittable_pdf light_pdf(*lights, rec.p);
+    mixture_pdf mixed_pdf(light_pdf, *srec.pdf_ptr);
 
     ray scattered(
         rec.p,
@@ -109,8 +128,448 @@ color ray_color(
            ) / pdf_val;
 }
 
+// Traces the same incoherent rays through one BVH in each node layout
+// and reports rays per second. The scene is sized so that its nodes
+// outgrow L2.
+void run_layout_benchmark() {
+    const int sphere_count = 300000;
+    const int ray_count = 1000000;
+
+    hittable_list scene;
+    auto white = std::make_shared<lambertian>(color(.73, .73, .73));
+
+    for (int i = 0; i < sphere_count; i++) {
+        scene.add(std::make_shared<sphere>(
+            random_vec3(0, 555), random_double(0.2, 1.5), white));
+    }
+
+    std::vector<ray> rays;
+    rays.reserve(ray_count);
+    for (int i = 0; i < ray_count; i++)
+        rays.emplace_back(random_vec3(0, 555), random_unit_vector());
+
+    bvh_build_options options;
+    options.split = bvh_split_method::sah;
+    options.parallel = true;
+
+    linear_bvh built(scene, 0.0, 1.0, options);
+
+    const std::pair<const char*, bvh_layout> layouts[] = {
+        {"depth-first", bvh_layout::depth_first},
+        {"larger child first", bvh_layout::larger_child_first},
+        {"treelet", bvh_layout::treelet},
+    };
+
+    std::cout << "Layout benchmark: " << sphere_count << " spheres, "
+              << built.memory_bytes() << " bytes of BVH, "
+              << ray_count << " rays\n";
+
+    for (const auto& layout : layouts) {
+        linear_bvh bvh = built;
+        bvh.reorder(layout.second, options.treelet_bytes);
+
+        int hits = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        #pragma omp parallel for schedule(dynamic, 1024) reduction(+:hits)
+        for (int i = 0; i < ray_count; i++) {
+            hit_record rec;
+            hits += bvh.hit(rays[i], interval(0.001, infinity), rec);
+        }
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        std::cout << "  " << layout.first << ": "
+                  << ray_count / elapsed.count() / 1e6 << " Mrays/s ("
+                  << hits << " hits)\n";
+    }
+}
+
+// Traces the same rays through a sphere field held as separate sphere
+// objects under a linear_bvh and as one sphere_set.
+void run_sphere_benchmark() {
+    const int sphere_count = 300000;
+    const int ray_count = 1000000;
+
+    std::vector<std::shared_ptr<material>> materials;
+    for (int i = 0; i < 8; i++)
+        materials.push_back(std::make_shared<lambertian>(random_vec3(0, 1)));
+
+    hittable_list scene;
+    std::vector<std::shared_ptr<sphere>> spheres;
+
+    for (int i = 0; i < sphere_count; i++) {
+        auto s = std::make_shared<sphere>(
+            random_vec3(0, 555), random_double(0.2, 1.5), materials[i % materials.size()]);
+        scene.add(s);
+        spheres.push_back(s);
+    }
+
+    std::vector<ray> rays;
+    rays.reserve(ray_count);
+    for (int i = 0; i < ray_count; i++)
+        rays.emplace_back(random_vec3(0, 555), random_unit_vector());
+
+    bvh_build_options options;
+    options.split = bvh_split_method::sah;
+    options.parallel = true;
+
+    const std::pair<const char*, std::shared_ptr<hittable>> variants[] = {
+        {"spheres in linear_bvh", std::make_shared<linear_bvh>(scene, 0.0, 1.0, options)},
+        {"sphere_set", std::make_shared<sphere_set>(spheres)},
+    };
+
+    std::cout << "Sphere benchmark: " << sphere_count << " spheres, "
+              << ray_count << " rays\n";
+
+    for (const auto& variant : variants) {
+        int hits = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        #pragma omp parallel for schedule(dynamic, 1024) reduction(+:hits)
+        for (int i = 0; i < ray_count; i++) {
+            hit_record rec;
+            hits += variant.second->hit(rays[i], interval(0.001, infinity), rec);
+        }
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        std::cout << "  " << variant.first << ": "
+                  << ray_count / elapsed.count() / 1e6 << " Mrays/s ("
+                  << hits << " hits)\n";
+    }
+}
+
+// Traces rays at a Mandelbulb sdf_hittable, under a linear_bvh with a
+// few spheres, for a range of step budgets. With RT_BVH_STATS it also
+// reports steps per march and how many marches ran out of steps.
+void run_sdf_benchmark() {
+    const int ray_count = 200000;
+
+    auto white = std::make_shared<lambertian>(color(.73, .73, .73));
+
+    std::vector<ray> rays;
+    rays.reserve(ray_count);
+    for (int i = 0; i < ray_count; i++) {
+        point3 origin = 4 * random_unit_vector();
+        rays.emplace_back(origin, random_vec3(-1, 1) - origin);
+    }
+
+    std::vector<std::shared_ptr<sphere>> spheres;
+    for (int i = 0; i < 8; i++)
+        spheres.push_back(std::make_shared<sphere>(2.5 * random_unit_vector(), 0.3, white));
+
+    // A box whose bounds are the box itself: every ray meets the surface
+    // exactly where it enters the bounds.
+    box solid(point3(-1, -1, -1), point3(1, 1, 1), white);
+    auto tight = make_sdf_hittable(
+        [](const point3& p) { return sdf_box(p, vec3(1, 1, 1)); },
+        aabb(point3(-1, -1, -1), point3(1, 1, 1)),
+        white);
+
+    int agree = 0;
+    for (const auto& r : rays) {
+        hit_record a, b;
+        bool hit_box = solid.hit(r, interval(0.001, infinity), a);
+        bool hit_sdf = tight->hit(r, interval(0.001, infinity), b);
+        agree += hit_box == hit_sdf && (!hit_box || fabs(a.t - b.t) < 1e-3);
+    }
+
+    std::cout << "SDF tight bounds: sdf_box agrees with box on "
+              << agree << " / " << ray_count << " rays\n";
+
+    std::cout << "SDF benchmark: Mandelbulb, " << ray_count << " rays\n";
+
+    for (int max_steps : {32, 64, 128, 256, 512}) {
+        sdf_options sdf;
+        sdf.max_steps = max_steps;
+        sdf.hit_epsilon = 1e-3;
+        sdf.step_scale = 0.8;
+
+        hittable_list scene;
+        scene.add(make_sdf_hittable(
+            [](const point3& p) { return sdf_mandelbulb(p); },
+            aabb(point3(-1.3, -1.3, -1.3), point3(1.3, 1.3, 1.3)),
+            white, sdf));
+        for (const auto& s : spheres)
+            scene.add(s);
+
+        linear_bvh world(scene, 0.0, 1.0);
+
+#ifdef RT_BVH_STATS
+        bvh_ray_counters before = bvh_counters_total();
+#endif
+
+        int hits = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        #pragma omp parallel reduction(+:hits)
+        {
+            #pragma omp for schedule(dynamic, 256)
+            for (int i = 0; i < ray_count; i++) {
+                hit_record rec;
+                hits += world.hit(rays[i], interval(0.001, infinity), rec);
+            }
+
+            bvh_flush_counters();
+        }
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        std::cout << "  " << max_steps << " steps: "
+                  << ray_count / elapsed.count() / 1e6 << " Mrays/s ("
+                  << hits << " hits)\n";
+
+#ifdef RT_BVH_STATS
+        bvh_ray_counters after = bvh_counters_total();
+        uint64_t marches = after.sdf_marches - before.sdf_marches;
+        std::cout << "    "
+                  << double(after.sdf_steps - before.sdf_steps) / marches
+                  << " steps per march, "
+                  << after.sdf_exhausted - before.sdf_exhausted
+                  << " out of steps\n";
+#endif
+    }
+}
+
+// Traces rays spread over the shutter through a sphere cluster where
+// two thirds of the spheres move, under a linear_bvh of swept boxes and
+// under a motion_bvh. With RT_BVH_STATS it also reports nodes visited
+// and primitives tested per ray.
+void run_motion_benchmark() {
+    const int sphere_count = 100000;
+    const int ray_count = 1000000;
+
+    auto white = std::make_shared<lambertian>(color(.73, .73, .73));
+
+    hittable_list scene;
+    for (int i = 0; i < sphere_count; i++) {
+        point3 center = random_vec3(0, 100);
+
+        if (i % 3 == 0)
+            scene.add(std::make_shared<sphere>(center, 0.5, white));
+        else
+            scene.add(std::make_shared<moving_sphere>(
+                center, center + random_vec3(-4, 4), 0.0, 1.0, 0.5, white));
+    }
+
+    std::vector<ray> rays;
+    rays.reserve(ray_count);
+    for (int i = 0; i < ray_count; i++)
+        rays.emplace_back(random_vec3(0, 100), random_unit_vector(), random_double());
+
+    bvh_build_options options;
+    options.split = bvh_split_method::sah;
+    options.parallel = true;
+
+    const std::pair<const char*, std::shared_ptr<hittable>> variants[] = {
+        {"linear_bvh", std::make_shared<linear_bvh>(scene, 0.0, 1.0, options)},
+        {"motion_bvh", std::make_shared<motion_bvh>(scene, 0.0, 1.0, options)},
+    };
+
+    std::cout << "Motion benchmark: " << sphere_count << " spheres, "
+              << sphere_count - sphere_count / 3 << " moving, "
+              << ray_count << " rays\n";
+
+    for (const auto& variant : variants) {
+#ifdef RT_BVH_STATS
+        bvh_ray_counters before = bvh_counters_total();
+#endif
+
+        int hits = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        #pragma omp parallel reduction(+:hits)
+        {
+            #pragma omp for schedule(dynamic, 1024)
+            for (int i = 0; i < ray_count; i++) {
+                hit_record rec;
+                hits += variant.second->hit(rays[i], interval(0.001, infinity), rec);
+            }
+
+            bvh_flush_counters();
+        }
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        std::cout << "  " << variant.first << ": "
+                  << ray_count / elapsed.count() / 1e6 << " Mrays/s ("
+                  << hits << " hits)\n";
+
+#ifdef RT_BVH_STATS
+        bvh_ray_counters after = bvh_counters_total();
+        std::cout << "    "
+                  << double(after.nodes_visited - before.nodes_visited) / ray_count
+                  << " nodes, "
+                  << double(after.primitives_tested - before.primitives_tested) / ray_count
+                  << " primitives per ray\n";
+#endif
+    }
+}
+
+// Loads an OBJ or binary mesh file and traces rays from outside its
+// bounds towards random points inside, reporting load time and rays
+// per second.
+void run_mesh_benchmark(const std::string& path) {
+    const int ray_count = 1000000;
+
+    auto white = std::make_shared<lambertian>(color(.73, .73, .73));
+    bool binary = std::filesystem::path(path).extension() == ".rtmesh";
+
+    auto load_start = std::chrono::steady_clock::now();
+    auto mesh = binary ? load_mesh_file(path, white) : obj_loader::load(path, white);
+    std::chrono::duration<double, std::milli> load_time =
+        std::chrono::steady_clock::now() - load_start;
+
+    if (!mesh)
+        return;
+
+    aabb bounds;
+    mesh->bounding_box(0, 0, bounds);
+
+    point3 center = bounds.centroid();
+    double radius = 0;
+    for (int a = 0; a < 3; a++)
+        radius = fmax(radius, bounds.axis_interval(a).size());
+
+    std::vector<ray> rays;
+    rays.reserve(ray_count);
+    for (int i = 0; i < ray_count; i++) {
+        point3 origin = center + 2 * radius * random_unit_vector();
+        point3 target(
+            random_double(bounds.x.min, bounds.x.max),
+            random_double(bounds.y.min, bounds.y.max),
+            random_double(bounds.z.min, bounds.z.max));
+        rays.emplace_back(origin, target - origin);
+    }
+
+    int hits = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    #pragma omp parallel for schedule(dynamic, 1024) reduction(+:hits)
+    for (int i = 0; i < ray_count; i++) {
+        hit_record rec;
+        hits += mesh->hit(rays[i], interval(0.001, infinity), rec);
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    std::cout << "Mesh benchmark: " << mesh->triangle_count()
+              << " triangles, " << mesh->memory_bytes() << " bytes, "
+              << "loaded and built in " << load_time.count() << " ms\n"
+              << "  " << ray_count / elapsed.count() / 1e6 << " Mrays/s ("
+              << hits << " hits)\n";
+}
+
+// Builds BVHs over inputs known to have broken them before and checks
+// the results. Returns the number of failed checks.
+int run_bvh_checks() {
+    int failures = 0;
+    auto check = [&](const char* name, bool ok) {
+        std::cout << (ok ? "  ok    " : "  FAIL  ") << name << "\n";
+        failures += !ok;
+    };
+
+    auto white = std::make_shared<lambertian>(color(.73, .73, .73));
+    auto any_leaf = [](uint32_t, uint32_t) { return true; };
+
+    // Spheres shrinking geometrically towards the origin: every SAH split
+    // peels off only the largest one, so an unbounded build nests one
+    // level per sphere.
+    {
+        std::vector<std::shared_ptr<hittable>> objects;
+        for (int i = 0; i < 300; i++) {
+            double x = std::pow(0.5, i);
+            objects.push_back(
+                std::make_shared<sphere>(point3(x, 0, 0), 0.1 * x, white));
+        }
+
+        bvh_build_options options;
+        options.split = bvh_split_method::sah;
+        options.max_leaf_size = 1;
+
+        bvh_node root(objects, 0, objects.size(), 0, 1, options);
+        linear_bvh flat(root, 0, 1);
+
+        check("flattened SAH bvh_node fits the traversal stack",
+              linear_bvh_nodes_valid(
+                  flat.nodes.data(), flat.nodes.size(), any_leaf));
+    }
+
+    // Floors cutting through a sphere field, which spatial splits clip
+    // into many references. Nothing moves, so a refit must not find the
+    // tree worse than it was built.
+    {
+        hittable_list scene;
+        for (int i = 0; i < 2000; i++)
+            scene.add(std::make_shared<sphere>(random_vec3(0, 100), 0.5, white));
+        for (int i = 0; i < 60; i++) {
+            scene.add(std::make_shared<quad>(
+                point3(0, random_double(0, 100), 0),
+                vec3(100, 0, 0), vec3(0, 0, 100), white));
+        }
+
+        bvh_build_options options;
+        options.split = bvh_split_method::sah;
+        options.spatial_splits = true;
+
+        linear_bvh bvh(scene, 0, 1, options);
+
+        check("SBVH splits the floors",
+              bvh.primitives.size() > scene.objects.size());
+        check("refitting an unchanged SBVH keeps it",
+              !bvh.refit_or_rebuild(0, 1));
+
+        // A tight budget that single splits across many floors can
+        // overrun if only checked before splitting.
+        std::vector<aabb> boxes(scene.objects.size());
+        for (size_t i = 0; i < boxes.size(); i++)
+            scene.objects[i]->bounding_box(0, 1, boxes[i]);
+
+        std::vector<bool> splittable(boxes.size(), true);
+        options.max_duplication = 0.01;
+        sbvh_builder tight(boxes, splittable, options);
+
+        check("SBVH stays within its duplication budget",
+              tight.indices.size() - boxes.size()
+                  <= static_cast<size_t>(boxes.size() * options.max_duplication));
+    }
+
+    std::cout << (failures ? "BVH checks failed\n" : "BVH checks passed\n");
+    return failures;
+}
+
 int main(int argc, char** argv) {
 
+    if (argc > 1 && std::string(argv[1]) == "--check")
+        return run_bvh_checks() ? 1 : 0;
+
+    if (argc > 3 && std::string(argv[1]) == "--convert") {
+        if (!convert_obj_to_mesh_file(argv[2], argv[3]))
+            return 1;
+        std::cout << "Wrote " << argv[3] << "\n";
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        if (argc > 2 && std::string(argv[2]) == "spheres")
+            run_sphere_benchmark();
+        else if (argc > 2 && std::string(argv[2]) == "sdf")
+            run_sdf_benchmark();
+        else if (argc > 2 && std::string(argv[2]) == "motion")
+            run_motion_benchmark();
+        else if (argc > 2)
+            run_mesh_benchmark(argv[2]);
+        else
+            run_layout_benchmark();
+        return 0;
+    }
+
     std::cout << "Max Threads: "
               << omp_get_max_threads() << "\n";
 
@@ -129,8 +588,27 @@ int main(int argc, char** argv) {
 
     std::string filename = "cornell_volume_box2.ppm";
 
-    if (argc > 1) {
-        filename = argv[1];
+    // --quantized traces compressed nodes instead of the wide BVH, for
+    // scenes whose BVH outgrows the caches. --dump-bvh writes a
+    // node-by-node listing of the tree to bvh_dump.txt beside the image.
+    // Any other argument names the output image.
+    bool compress_bvh = false;
+    bool write_bvh_dump = false;
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+
+        if (arg == "--quantized") {
+            compress_bvh = true;
+            continue;
+        }
+
+        if (arg == "--dump-bvh") {
+            write_bvh_dump = true;
+            continue;
+        }
+
+        filename = arg;
         if (filename.size() < 4 ||
             filename.substr(filename.size() - 4) != ".ppm") {
             filename += ".ppm";
@@ -164,9 +642,18 @@ int main(int argc, char** argv) {
     auto green = std::make_shared<lambertian>(color(.12, .45, .15));
     auto light = std::make_shared<diffuse_light>(color(20, 20, 20));
 
-    world.add(std::make_shared<yz_rect>(0,555,0,555,555, green));
-    world.add(std::make_shared<flip_face>(
-        std::make_shared<yz_rect>(0,555,0,555,0, red)));
+    // Each quad's normal is cross(u, v), and the edge orders keep the
+    // orientations the rects and flip_face wrappers used to give: floor,
+    // ceiling and back wall face into the room, the green (+x) and red
+    // (-x) side walls face out of it. Lambertian walls scatter the same
+    // from either side.
+    world.add(std::make_shared<quad_set>(std::vector<std::shared_ptr<quad>>{
+        std::make_shared<quad>(point3(555,0,0), vec3(0,555,0), vec3(0,0,555), green),
+        std::make_shared<quad>(point3(0,0,0), vec3(0,0,555), vec3(0,555,0), red),
+        std::make_shared<quad>(point3(0,0,0), vec3(0,0,555), vec3(555,0,0), white),
+        std::make_shared<quad>(point3(0,555,0), vec3(555,0,0), vec3(0,0,555), white),
+        std::make_shared<quad>(point3(0,0,555), vec3(0,555,0), vec3(555,0,0), white)
+    }));
 
     auto sphere_light =
         std::make_shared<sphere>(
@@ -178,20 +665,20 @@ int main(int argc, char** argv) {
     world.add(sphere_light);
     lights.add(sphere_light);
 
-    world.add(std::make_shared<xz_rect>(0,555,0,555,0, white));
-    world.add(std::make_shared<flip_face>(
-        std::make_shared<xz_rect>(0,555,0,555,555, white)));
-    world.add(std::make_shared<flip_face>(
-        std::make_shared<xy_rect>(0,555,0,555,555, white)));
-
-    std::shared_ptr<hittable> box1 =
+    // Both boxes instance one shared unit box, each through a single
+    // object-to-world matrix.
+    auto unit_box = make_blas(hittable_list(
         std::make_shared<box>(
             point3(0,0,0),
-            point3(165,330,165),
-            white);
+            point3(1,1,1),
+            white)));
 
-    box1 = std::make_shared<rotate_y>(box1, 15);
-    box1 = std::make_shared<translate>(box1, vec3(265,0,295));
+    std::shared_ptr<hittable> box1 =
+        std::make_shared<transform_instance>(
+            unit_box,
+            mat3x4::translation(vec3(265,0,295))
+          * mat3x4::rotation_y(15)
+          * mat3x4::scaling(vec3(165,330,165)));
 
     world.add(box1);
 
@@ -202,13 +689,11 @@ int main(int argc, char** argv) {
     ));
 
     std::shared_ptr<hittable> box2 =
-        std::make_shared<box>(
-            point3(0,0,0),
-            point3(165,165,165),
-            white);
-
-    box2 = std::make_shared<rotate_y>(box2, -18);
-    box2 = std::make_shared<translate>(box2, vec3(130,0,65));
+        std::make_shared<transform_instance>(
+            unit_box,
+            mat3x4::translation(vec3(130,0,65))
+          * mat3x4::rotation_y(-18)
+          * mat3x4::scaling(vec3(165,165,165)));
 
     world.add(box2);
 
@@ -218,16 +703,67 @@ int main(int argc, char** argv) {
     //     color(1,1,1)
     // ));
 
-    world = hittable_list(
-        std::make_shared<bvh_node>(
-            world.objects,
-            0,
-            world.objects.size(),
-            0.0,
-            1.0
-        )
+    bvh_build_options bvh_options;
+    bvh_options.split = bvh_split_method::sah;
+    bvh_options.parallel = true;
+    bvh_options.spatial_splits = true;
+
+    auto build_start = std::chrono::steady_clock::now();
+
+    // Trees are cached by scene geometry, so re-rendering the same
+    // scene with another camera or sample count skips the build.
+    bool bvh_from_cache = false;
+
+    auto bvh = cached_linear_bvh(
+        world,
+        0.0,
+        1.0,
+        bvh_options,
+        build_dir / "bvh_cache",
+        &bvh_from_cache
     );
 
+    std::chrono::duration<double, std::milli> build_time =
+        std::chrono::steady_clock::now() - build_start;
+
+    double build_rate =
+        world.objects.size() / (build_time.count() / 1000.0);
+
+    std::cout << (bvh_from_cache ? "BVH load: " : "BVH build: ")
+              << build_time.count() << " ms ("
+              << build_rate << " primitives/s), "
+              << bvh->node_count() << " nodes, "
+              << bvh->primitives.size() << " references to "
+              << world.objects.size() << " objects, "
+              << bvh->memory_bytes() << " bytes, "
+              << "SAH cost: " << bvh->sah_cost(bvh_options) << "\n";
+
+    compute_bvh_stats(*bvh, bvh_options).print(std::cout);
+
+    if (write_bvh_dump) {
+        std::ofstream dump(render_dir / "bvh_dump.txt");
+        dump_bvh(*bvh, dump);
+    }
+
+    auto wide = std::make_shared<wide_bvh<wide_bvh_default_width>>(*bvh);
+
+    std::cout << "BVH" << wide_bvh_default_width << ": "
+              << wide->node_count() << " nodes, "
+              << wide->memory_bytes() << " bytes\n";
+
+    if (compress_bvh) {
+        auto compressed = std::make_shared<quantized_bvh<uint8_t>>(*bvh);
+
+        std::cout << "Quantized BVH: "
+                  << compressed->bytes_per_node() << " bytes per node, "
+                  << compressed->memory_bytes() << " bytes\n";
+
+        world = hittable_list(compressed);
+    }
+    else {
+        world = hittable_list(wide);
+    }
+
     auto lights_ptr =
         std::make_shared<hittable_list>(lights);
 
@@ -252,6 +788,10 @@ int main(int argc, char** argv) {
     std::vector<color> framebuffer(image_width * image_height);
     std::atomic<int> rows_done = 0;
 
+#ifdef RT_ALLOC_STATS
+    uint64_t allocations_before = heap_allocations();
+#endif
+
     #pragma omp parallel for schedule(dynamic)
     for (int j = 0; j < image_height; ++j) {
 
@@ -278,6 +818,8 @@ int main(int argc, char** argv) {
             framebuffer[j * image_width + i] = pixel_color;
         }
 
+        bvh_flush_counters();
+
         int done = ++rows_done;
 
         #pragma omp critical
@@ -291,6 +833,32 @@ int main(int argc, char** argv) {
 
     std::cerr << "\nRendering finished.\n";
 
+#ifdef RT_ALLOC_STATS
+    uint64_t render_allocations = heap_allocations() - allocations_before;
+
+    std::cout << "Heap allocations while rendering: " << render_allocations
+              << " (" << double(render_allocations)
+                         / (double(image_width) * image_height * samples_per_pixel)
+              << " per sample)\n";
+#endif
+
+#ifdef RT_BVH_STATS
+    bvh_ray_counters counters = bvh_counters_total();
+
+    std::cout << "Rays: " << counters.rays << ", "
+              << double(counters.nodes_visited) / counters.rays
+              << " nodes visited and "
+              << double(counters.primitives_tested) / counters.rays
+              << " primitives tested per ray\n";
+
+    if (counters.sdf_marches > 0) {
+        std::cout << "SDF marches: " << counters.sdf_marches << ", "
+                  << double(counters.sdf_steps) / counters.sdf_marches
+                  << " steps per march, "
+                  << counters.sdf_exhausted << " out of steps\n";
+    }
+#endif
+
     for (int j = image_height - 1; j >= 0; --j) {
         for (int i = 0; i < image_width; ++i) {
 
@@ -21,14 +21,10 @@ public:
         scatter_record& srec
     ) const override {
 
-        srec.is_specular = false;
-        srec.attenuation = albedo->value(rec.u, rec.v, rec.p);
-
         // uniform sphere sampling
         srec.is_specular = false;
         srec.attenuation = albedo->value(rec.u, rec.v, rec.p);
-        srec.pdf_ptr = std::make_shared<sphere_pdf>();
-        return true;
+        srec.pdf_ptr = &srec.sphere;
 
         return true;
     }
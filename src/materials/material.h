@@ -6,15 +6,26 @@
 #include "onb.h"
 #include "random.h"
 #include "cosine_pdf.h"
+#include "sphere_pdf.h"
 
 #include "hittable.h"
 #include "texture.h"
 
+// pdf_ptr points into the record's own storage for the PDF kinds the
+// materials scatter with, so a diffuse bounce allocates nothing. It is
+// only valid while the record lives and is not copied.
 struct scatter_record {
     ray specular_ray;
     bool is_specular;
     color attenuation;
-    std::shared_ptr<pdf> pdf_ptr;
+    const pdf* pdf_ptr = nullptr;
+
+    cosine_pdf cosine;
+    sphere_pdf sphere;
+
+    scatter_record() = default;
+    scatter_record(const scatter_record&) = delete;
+    scatter_record& operator=(const scatter_record&) = delete;
 };
 
 class material {
@@ -68,8 +79,8 @@ public:
         srec.attenuation =
             albedo->value(rec.u, rec.v, rec.p);
 
-        srec.pdf_ptr =
-            std::make_shared<cosine_pdf>(rec.normal);
+        srec.cosine = cosine_pdf(rec.normal);
+        srec.pdf_ptr = &srec.cosine;
 
         return true;
     }
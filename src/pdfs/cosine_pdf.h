@@ -7,6 +7,8 @@
 
 class cosine_pdf : public pdf {
 public:
+    cosine_pdf() {}
+
     cosine_pdf(const vec3& w) {
         uvw.build_from_w(w);
     }
@@ -6,19 +6,19 @@
 
 class hittable_pdf : public pdf {
 public:
-    hittable_pdf(shared_ptr<hittable> objects, const point3& origin)
+    hittable_pdf(const hittable& objects, const point3& origin)
         : objects(objects), origin(origin) {}
 
     double value(const vec3& direction) const override {
-        return objects->pdf_value(origin, direction);
+        return objects.pdf_value(origin, direction);
     }
 
     vec3 generate() const override {
-        return objects->random(origin);
+        return objects.random(origin);
     }
 
 private:
-    shared_ptr<hittable> objects;
+    const hittable& objects;
     point3 origin;
 };
 
@@ -2,14 +2,13 @@
 #define MIXTURE_PDF_H
 
 #include "pdf.h"
-#include <memory>
-
-using std::shared_ptr;
 
+// Borrows both PDFs, which must outlive it; in the integrator all three
+// live on the stack for one path vertex.
 class mixture_pdf : public pdf {
 public:
-    mixture_pdf(shared_ptr<pdf> p0, shared_ptr<pdf> p1)
-        : p{p0, p1} {}
+    mixture_pdf(const pdf& p0, const pdf& p1)
+        : p{&p0, &p1} {}
 
     double value(const vec3& direction) const override {
         return 0.5 * p[0]->value(direction)
@@ -24,7 +23,7 @@ public:
     }
 
 private:
-    shared_ptr<pdf> p[2];
+    const pdf* p[2];
 };
 
 #endif
\ No newline at end of file